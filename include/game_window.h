@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
 #include "gtk_board.h"
 #include "window.h"
@@ -40,18 +41,29 @@ class GameWindow : public Window {
   virtual void on_board_position_changed() = 0;
 
  private:
+  // Main line positions are saved every kKeyframeInterval moves, so that
+  // goto_move() replays at most that many moves in the rules engine.
+  static constexpr size_t kKeyframeInterval = 16;
+  // Ko rule of the "chinese" rules KataGo is queried with, so that the moves
+  // the board accepts are the ones the engine does.
+  static constexpr wq::KoRule kKoRule = wq::KoRule::kSimple;
+
   // State
   wq::Color turn_ = wq::Color::kBlack;
   std::unique_ptr<wq::Board> board_;
   size_t cur_move_ = 0;
   wq::MoveList moves_;
   wq::MoveList variation_moves_;
+  std::vector<wq::Board::Snapshot> keyframes_;
 
   // Widgets
   std::unique_ptr<GtkBoard> goban_;
   GtkWidget* navigation_bar_;
 
   void play_move_sound(size_t capture_count);
+  void truncate_mainline();
+  void update_keyframes();
+  void annotate_last_move();
 
   static void on_first_move_clicked(GtkWidget* self, gpointer user_data);
   static void on_prev_n_moves_clicked(GtkWidget* self, gpointer user_data);
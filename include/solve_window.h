@@ -43,6 +43,7 @@ class SolveWindow : public Window {
   std::unique_ptr<TaskVTreeIterator> solve_state_;
   std::set<wq::Point> pending_answer_points_;
   std::unique_ptr<wq::Board> board_;
+  wq::Board::Snapshot initial_position_;
   std::optional<AnswerType> task_result_;
   bool session_complete_ = false;
   int total_solve_time_ = 0;
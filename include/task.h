@@ -3,6 +3,7 @@
 #include <sqlite3.h>
 
 #include <cassert>
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <nlohmann/json.hpp>
@@ -93,12 +94,52 @@ enum class AnswerType {
   kWrong,
 };
 
+// Node of a variation tree being built, as by importers. Tasks keep their
+// trees as a TaskVTree.
 struct TreeNode {
   std::map<wq::Point, std::unique_ptr<TreeNode>> children_;
   std::string comment_;
   std::optional<AnswerType> answer_;
 };
 
+// Variation tree with all of its nodes in one array and all of its comments
+// in one string, so that a task owns a few allocations however large its tree
+// is. Node 0 is the root, and the children of every node are a range of
+// nodes sorted by move.
+struct TaskVTree {
+  struct Node {
+    // Move from the parent to this node; kPass for the root.
+    wq::Point move_ = wq::kPass;
+    std::optional<AnswerType> answer_;
+    uint32_t first_child_ = 0;
+    uint32_t child_count_ = 0;
+    // Range of the comment in comments_.
+    uint32_t comment_offset_ = 0;
+    uint32_t comment_size_ = 0;
+  };
+
+  std::vector<Node> nodes_;
+  std::string comments_;
+
+  TaskVTree() = default;
+  explicit TaskVTree(const TreeNode& root);
+
+  bool empty() const { return nodes_.empty(); }
+  const Node& root() const { return nodes_[0]; }
+  const Node* children_begin(const Node& node) const {
+    return nodes_.data() + node.first_child_;
+  }
+  const Node* children_end(const Node& node) const {
+    return nodes_.data() + node.first_child_ + node.child_count_;
+  }
+  // Child of node reached by playing p, or nullptr if there is none.
+  const Node* child(const Node& node, const wq::Point& p) const;
+  std::string_view comment(const Node& node) const {
+    return std::string_view(comments_).substr(node.comment_offset_,
+                                              node.comment_size_);
+  }
+};
+
 struct Task {
   int64_t id_;
   std::string source_;
@@ -115,7 +156,7 @@ struct Task {
   wq::PointList initial_[2];
   wq::PointList answer_points_;
   std::map<wq::Point, std::string> labels_;
-  std::unique_ptr<TreeNode> vtree_;
+  TaskVTree vtree_;
 };
 
 struct SolvePreset {
@@ -158,7 +199,9 @@ struct BookChapter {
 
 class TaskDB {
  public:
-  TaskDB(const char* path);
+  // A read-only database is opened as is, without applying the schema, so
+  // that several connections can read it concurrently.
+  TaskDB(const char* path, bool read_only = false);
   ~TaskDB();
 
   int64_t get_tag_id(std::string_view tag_name) const;
@@ -168,6 +211,10 @@ class TaskDB {
   int64_t add_task(const Task& task);
   std::optional<Task> get_task(int64_t id) const;
   std::vector<int64_t> get_tasks(SolvePreset preset) const;
+  // Steps of the plan SQLite picks for the query of get_tasks(preset), as
+  // reported by EXPLAIN QUERY PLAN.
+  std::vector<std::string> get_tasks_query_plan(
+      const SolvePreset& preset) const;
 
   int64_t add_book(const Book& book);
   std::vector<Book> list_books() const;
@@ -180,8 +227,50 @@ class TaskDB {
   std::vector<Task> list_book_tasks(int64_t book_id,
                                     std::optional<int64_t> chapter_id) const;
 
+  // Writer for large imports. Inserts are grouped batch_size at a time into
+  // transactions instead of committing each statement, tag ids are cached in
+  // memory, and secondary indexes are dropped while writing and rebuilt once
+  // by finish(). The database must not be used for anything else until then.
+  class BulkWriter {
+   public:
+    explicit BulkWriter(TaskDB& db, int batch_size = 10000);
+    ~BulkWriter();
+    BulkWriter(const BulkWriter&) = delete;
+    BulkWriter& operator=(const BulkWriter&) = delete;
+
+    int64_t add_tag(std::string_view tag_name);
+    int64_t add_task(const Task& task);
+    void add_book_task(int64_t book_id, int64_t chapter_id, int64_t task_id);
+    // Commits the pending inserts and rebuilds the indexes. Returns false if
+    // any of it failed; called by the destructor if needed.
+    bool finish();
+
+   private:
+    TaskDB& db_;
+    const int batch_size_;
+    int pending_ = 0;
+    bool finished_ = false;
+    std::unordered_map<std::string, int64_t> tag_ids_;
+    // Statements recreating the dropped indexes.
+    std::vector<std::string> index_sql_;
+
+    bool exec(const char* sql);
+    // Counts an insert and commits the batch once it is full.
+    void inserted();
+  };
+
  private:
   sqlite3* db_;
+  // Statements by SQL text. Each is prepared on first use and reset after
+  // every call, so SQLite only parses and plans a query once per connection.
+  mutable std::unordered_map<std::string, sqlite3_stmt*> statements_;
+
+  sqlite3_stmt* prepare(const std::string& sql) const;
+  // Runs a statement that returns no rows, logging errors for caller.
+  bool step_done(sqlite3_stmt* stmt, const char* caller) const;
+  // SQL selecting the ids of the tasks matching preset, with a parameter for
+  // every filter value.
+  static std::string tasks_query(const SolvePreset& preset);
 
   // Serialization
   static std::string encode_point(const wq::Point& p);
@@ -189,32 +278,29 @@ class TaskDB {
   static json encode_task_initial_stones(const Task& task);
   static json encode_task_answer_points(const Task& task);
   static json encode_task_labels(const Task& task);
-  static json encode_task_vtree_node(const TreeNode* node);
+  static json encode_task_vtree_node(const TaskVTree& tree,
+                                    const TaskVTree::Node& node);
   static json encode_task_vtree(const Task& task);
+  // Binary form of the vtree stored as a BLOB, or nothing if it has points
+  // off the board, in which case it is stored as JSON.
+  static std::optional<std::string> encode_task_vtree_blob(const Task& task);
   static json encode_metadata(const Task& task);
 
   // Deserialization
   static wq::Point decode_point(std::string_view s);
   static wq::PointList decode_point_list(const json& j);
   static std::unique_ptr<TreeNode> decode_task_vtree(const json& j);
+  // Decodes a vtree BLOB of a task whose board size and region are set.
+  // Returns nothing if the data is malformed.
+  static std::optional<TaskVTree> decode_task_vtree_blob(std::string_view data,
+                                                         const Task& task);
+
+  // Upgrades the tables of databases written by older versions, as tracked
+  // by PRAGMA user_version.
+  void migrate();
 
-  // Callbacks
-  static int get_tag_id_cb(void* out, int column_count, char** column_value,
-                           char** column_name);
-  static int get_tag_cb(void* out, int column_count, char** column_value,
-                        char** column_name);
-  static int get_tasks_cb(void* out, int column_count, char** column_value,
-                          char** column_name);
-  static int get_task_cb(void* out, int column_count, char** column_value,
-                         char** column_name);
-  static int list_books_cb(void* out, int column_count, char** column_value,
-                           char** column_name);
-  static int list_book_chapters_cb(void* out, int column_count,
-                                   char** column_value, char** column_name);
-  static int add_book_chapter_cb(void* out, int column_count,
-                                 char** column_value, char** column_name);
-  static int list_book_tasks_cb(void* out, int column_count,
-                                char** column_value, char** column_name);
+  // Reads a row of the kTaskColumns columns.
+  static std::optional<Task> read_task(sqlite3_stmt* stmt);
 };
 
 class TaskVTreeIterator {
@@ -227,17 +313,14 @@ class TaskVTreeIterator {
 
   template <class Generator>
   const wq::Point& gen_move(Generator& gen) const {
-    assert(!cur_->children_.empty());
-    std::uniform_int_distribution<> dist(0, cur_->children_.size() - 1);
-    int index = dist(gen);
-    auto it = cur_->children_.begin();
-    for (int i = 0; i < index; ++i) ++it;
-    return it->first;
+    assert(cur_ && cur_->child_count_ > 0);
+    std::uniform_int_distribution<> dist(0, cur_->child_count_ - 1);
+    return task_.vtree_.children_begin(*cur_)[dist(gen)].move_;
   }
 
  private:
   const Task& task_;
-  TreeNode* cur_;
+  const TaskVTree::Node* cur_;
 };
 
 const char* rank_string(Rank rank);
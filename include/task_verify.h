@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "task.h"
+
+// Problem found while replaying a task.
+struct TaskProblem {
+  int64_t task_id;
+  // Moves leading to the problem, as SGF points separated by spaces ("tt" is
+  // a pass). Empty for problems in the initial position.
+  std::string path;
+  std::string message;
+};
+
+struct TaskVerifyReport {
+  int64_t task_count = 0;
+  // Sorted by task id.
+  std::vector<TaskProblem> problems;
+};
+
+// Replays the initial stones of a task and every path of its variation tree
+// on a wq::Board, and reports out-of-bounds points, occupied points, suicides
+// and superko violations.
+std::vector<TaskProblem> verify_task(const Task& task);
+
+// Verifies every task of the database at db_path on thread_count workers, or
+// one per hardware thread if 0. Task ids are dealt to per-worker queues and
+// idle workers steal from the others; each worker reads the tasks through its
+// own read-only connection.
+TaskVerifyReport verify_tasks(const char* db_path, int thread_count);
+
+// Command-line entry point: verifies the database, prints the problems found
+// to standard output and returns a process exit code.
+int verify_tasks_main(const char* db_path, int thread_count);
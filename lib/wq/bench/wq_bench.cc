@@ -0,0 +1,407 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "life_and_death.h"
+#include "playout.h"
+#include "sgf.h"
+#include "wq.h"
+
+// Every allocation made by the process is counted, so that each case can
+// report how many allocations a move costs.
+static uint64_t alloc_count = 0;
+
+void *operator new(size_t size) {
+  alloc_count++;
+  if (void *p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr wq::Color kBlack = wq::Color::kBlack;
+constexpr wq::Color kWhite = wq::Color::kWhite;
+
+// Work done by a case, accumulated over all its iterations.
+struct Stats {
+  double move_seconds = 0;
+  double undo_seconds = 0;
+  int64_t move_count = 0;
+  int64_t undo_count = 0;
+  uint64_t move_allocs = 0;
+};
+
+void report(const std::string &name, const Stats &s) {
+  std::cout << std::left << std::setw(28) << name << std::right << std::fixed
+            << std::setprecision(0) << std::setw(12)
+            << s.move_count / s.move_seconds << " moves/s" << std::setw(8)
+            << 1e9 * s.move_seconds / s.move_count << " ns/move";
+  if (s.undo_count > 0) {
+    std::cout << std::setw(8) << 1e9 * s.undo_seconds / s.undo_count
+              << " ns/undo";
+  } else {
+    std::cout << std::setw(16) << "";
+  }
+  std::cout << std::setw(8) << std::setprecision(3)
+            << double(s.move_allocs) / s.move_count << " allocs/move"
+            << std::endl;
+}
+
+wq::Color opponent(wq::Color col) { return col == kBlack ? kWhite : kBlack; }
+
+// Plays random legal moves on an empty board until the side to move has
+// tried every empty point once without finding a legal move, or the game
+// reaches max_moves, and appends them to record. Nothing is timed, so that
+// cases can replay the records and only measure the rules engine.
+void random_game(int size, std::mt19937 &gen, int max_moves,
+                 wq::MoveList &record) {
+  wq::Board board(size, size);
+  std::vector<wq::Point> empty;
+  wq::PointList removed;
+  wq::Color col = kBlack;
+  for (int i = 0; i < max_moves; ++i) {
+    empty.clear();
+    for (int r = 0; r < size; ++r) {
+      for (int c = 0; c < size; ++c) {
+        if (board.at(r, c) == wq::Color::kNone) empty.emplace_back(r, c);
+      }
+    }
+    bool played = false;
+    while (!empty.empty() && !played) {
+      const size_t k = gen() % empty.size();
+      const auto [r, c] = empty[k];
+      played = board.move(col, r, c, removed);
+      if (played) {
+        record.emplace_back(col, wq::Point(r, c));
+      } else {
+        empty[k] = empty.back();
+        empty.pop_back();
+      }
+    }
+    if (!played) break;
+    col = opponent(col);
+  }
+}
+
+// Empty size x size board of the implementation a case measures.
+template <class B>
+B empty_board(int size) {
+  return B(size, size);
+}
+
+template <>
+wq::BitBoard empty_board(int) {
+  return wq::BitBoard();
+}
+
+// Replays records on fresh boards, optionally undoing every move afterwards.
+// The boards of a repetition are built beforehand and all of its moves, then
+// all of its undos, are timed as one batch, so that clock reads do not weigh
+// on the cost of a move.
+template <class B = wq::Board>
+void replay(const std::vector<wq::MoveList> &records, int size,
+            int repetitions, bool undo, Stats &s) {
+  wq::PointList removed;
+  wq::PointList added;
+  std::vector<B> boards;
+  for (int i = 0; i < repetitions; ++i) {
+    boards.clear();
+    boards.reserve(records.size());
+    for (size_t k = 0; k < records.size(); ++k) {
+      boards.push_back(empty_board<B>(size));
+    }
+
+    const uint64_t allocs = alloc_count;
+    auto start = Clock::now();
+    for (size_t k = 0; k < records.size(); ++k) {
+      for (const auto &[col, p] : records[k]) {
+        if (!boards[k].move(col, p.first, p.second, removed)) {
+          std::cerr << "replay: illegal move in record" << std::endl;
+          std::exit(1);
+        }
+      }
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    s.move_seconds += elapsed.count();
+    s.move_allocs += alloc_count - allocs;
+    for (const auto &record : records) s.move_count += record.size();
+    if (!undo) continue;
+
+    start = Clock::now();
+    int r, c;
+    for (auto &board : boards) {
+      while (board.undo(r, c, added)) s.undo_count++;
+    }
+    elapsed = Clock::now() - start;
+    s.undo_seconds += elapsed.count();
+  }
+}
+
+// Moves of a ladder starting near the top-left corner and running diagonally
+// down to the bottom edge, where black captures the whole white chain.
+wq::MoveList ladder_record(int size) {
+  wq::MoveList moves;
+  const auto add = [&](wq::Color col, int r, int c) {
+    moves.emplace_back(col, wq::Point(r, c));
+  };
+  add(kBlack, 0, 1);
+  add(kBlack, 1, 0);
+  add(kBlack, 2, 0);
+  add(kWhite, 1, 1);
+  for (int k = 0;; ++k) {
+    add(kBlack, 1 + k, 2 + k);
+    add(kWhite, 2 + k, 1 + k);
+    if (3 + k == size) {
+      // The edge took the other liberty.
+      add(kBlack, 2 + k, 2 + k);
+      break;
+    }
+    add(kBlack, 3 + k, 1 + k);
+    add(kWhite, 2 + k, 2 + k);
+  }
+  return moves;
+}
+
+// Moves filling the top rows with a white chain that black then encloses and
+// captures with its last move.
+wq::MoveList large_capture_record(int size) {
+  wq::MoveList moves;
+  const int rows = size / 2;
+  for (int r = 0; r < rows; ++r) {
+    for (int c = 0; c < size; ++c) {
+      if (r != 0 || c != 0) moves.emplace_back(kWhite, wq::Point(r, c));
+    }
+  }
+  for (int c = 0; c < size; ++c) moves.emplace_back(kBlack, wq::Point(rows, c));
+  moves.emplace_back(kBlack, wq::Point(0, 0));
+  return moves;
+}
+
+// Walks back and forth through a record the way a game viewer does: random
+// jumps implemented as runs of undo or move.
+void navigate(const wq::MoveList &record, int size, std::mt19937 &gen,
+              int jump_count, Stats &s) {
+  wq::Board board(size, size);
+  wq::PointList removed;
+  wq::PointList added;
+  size_t cur = 0;
+  for (int i = 0; i < jump_count; ++i) {
+    const size_t target = gen() % (record.size() + 1);
+    if (target < cur) s.undo_count += cur - target;
+    if (target > cur) s.move_count += target - cur;
+    const uint64_t allocs = alloc_count;
+    const auto start = Clock::now();
+    int r, c;
+    for (; cur > target; --cur) board.undo(r, c, added);
+    const auto mid = Clock::now();
+    for (; cur < target; ++cur) {
+      const auto &[col, p] = record[cur];
+      board.move(col, p.first, p.second, removed);
+    }
+    const auto end = Clock::now();
+    const std::chrono::duration<double> undo_elapsed = mid - start;
+    const std::chrono::duration<double> move_elapsed = end - mid;
+    s.undo_seconds += undo_elapsed.count();
+    s.move_seconds += move_elapsed.count();
+    s.move_allocs += alloc_count - allocs;
+  }
+}
+
+}  // namespace
+
+int main() {
+  constexpr int kPlayoutCount = 500;
+  constexpr int kRecordCount = 200;
+  constexpr int kRepetitions = 20;
+
+  std::mt19937 gen(1);
+
+  for (const int size : {9, 13, 19}) {
+    std::vector<wq::MoveList> games(kPlayoutCount);
+    for (auto &game : games) random_game(size, gen, 3 * size * size, game);
+
+    Stats stats;
+    replay(games, size, 1, false, stats);
+    report("playout " + std::to_string(size), stats);
+
+    // The same games on the bit mask board, which only exists in 19x19.
+    if (size == wq::BitBoard::kSize) {
+      Stats bit_stats;
+      replay<wq::BitBoard>(games, size, 1, false, bit_stats);
+      report("playout BitBoard " + std::to_string(size), bit_stats);
+    }
+  }
+
+  // Records of complete 19x19 games, played in advance so that replaying
+  // them only measures the rules engine.
+  std::vector<wq::MoveList> records(kRecordCount);
+  for (auto &record : records) random_game(19, gen, 3 * 19 * 19, record);
+
+  Stats replay_stats;
+  replay(records, 19, kRepetitions, false, replay_stats);
+  report("replay 19", replay_stats);
+
+  Stats undo_stats;
+  replay(records, 19, kRepetitions, true, undo_stats);
+  report("replay+undo 19", undo_stats);
+
+  // Short records, so they are replayed on many boards at once.
+  Stats ladder_stats;
+  replay(std::vector<wq::MoveList>(100, ladder_record(19)), 19, kRepetitions,
+         true, ladder_stats);
+  report("ladder 19", ladder_stats);
+
+  Stats capture_stats;
+  replay(std::vector<wq::MoveList>(100, large_capture_record(19)), 19,
+         kRepetitions, true, capture_stats);
+  report("large capture 19", capture_stats);
+
+  Stats navigate_stats;
+  for (const auto &record : records) {
+    navigate(record, 19, gen, kRepetitions, navigate_stats);
+  }
+  report("navigate 19", navigate_stats);
+
+  // Symmetry-canonical hashes of the final positions of the records.
+  {
+    std::vector<wq::Board> boards;
+    wq::PointList removed;
+    for (const auto &record : records) {
+      boards.emplace_back(19, 19);
+      for (const auto &[col, p] : record) {
+        boards.back().move(col, p.first, p.second, removed);
+      }
+    }
+    const auto start = Clock::now();
+    for (int i = 0; i < kRepetitions; ++i) {
+      for (const auto &board : boards) board.canonical_hash();
+    }
+    const std::chrono::duration<double> elapsed = Clock::now() - start;
+    std::cout << std::left << std::setw(28) << "canonical hash 19"
+              << std::right << std::setw(12) << std::setprecision(0)
+              << kRepetitions * boards.size() / elapsed.count()
+              << " hashes/s" << std::endl;
+  }
+
+  // Reading a collection of the records written as SGF, as done when
+  // importing game collections.
+  {
+    std::string collection;
+    wq::SgfGame game;
+    game.komi = 6.5;
+    game.black_player = "Black";
+    game.white_player = "White";
+    for (const auto &record : records) {
+      game.moves = record;
+      wq::write_sgf(game, collection);
+    }
+    wq::SgfReader warm_up(collection);
+    while (warm_up.next(game)) {
+    }
+    int64_t game_count = 0;
+    int64_t move_count = 0;
+    const uint64_t allocs = alloc_count;
+    const auto start = Clock::now();
+    for (int i = 0; i < kRepetitions; ++i) {
+      wq::SgfReader reader(collection);
+      while (reader.next(game)) {
+        game_count++;
+        move_count += game.moves.size();
+      }
+    }
+    const std::chrono::duration<double> elapsed = Clock::now() - start;
+    std::cout << std::left << std::setw(28) << "sgf read 19" << std::right
+              << std::setw(12) << std::setprecision(0)
+              << game_count / elapsed.count() << " games/s" << std::setw(8)
+              << kRepetitions * collection.size() / elapsed.count() / 1e6
+              << " MB/s" << std::setw(8) << std::setprecision(3)
+              << double(alloc_count - allocs) / move_count << " allocs/move"
+              << std::endl;
+  }
+
+  // Reading the full-board ladder from its first atari.
+  {
+    constexpr int kReadCount = 2000;
+    const wq::MoveList ladder = ladder_record(19);
+    wq::Board board(19, 19);
+    wq::PointList removed;
+    for (int i = 0; i < 5; ++i) {
+      const auto &[col, p] = ladder[i];
+      board.move(col, p.first, p.second, removed);
+    }
+    wq::MoveList line;
+    const uint64_t allocs = alloc_count;
+    const auto start = Clock::now();
+    for (int i = 0; i < kReadCount; ++i) board.ladder_capture(1, 1, line);
+    const std::chrono::duration<double> elapsed = Clock::now() - start;
+    std::cout << std::left << std::setw(28) << "ladder read 19" << std::right
+              << std::setw(12) << std::setprecision(0)
+              << kReadCount / elapsed.count() << " reads/s" << std::setw(8)
+              << std::setprecision(3)
+              << double(alloc_count - allocs) / kReadCount << " allocs/read"
+              << std::endl;
+  }
+
+  // Solving a rectangular six in the corner with no outside liberties, which
+  // black kills.
+  {
+    constexpr int kSolveCount = 50;
+    wq::Board board(19, 19);
+    wq::PointList removed;
+    for (const auto &[r, c] :
+         wq::PointList{{2, 0}, {2, 1}, {2, 2}, {2, 3}, {1, 3}, {0, 3}}) {
+      board.move(kWhite, r, c, removed);
+    }
+    for (const auto &[r, c] : wq::PointList{
+             {3, 0}, {3, 1}, {3, 2}, {3, 3}, {3, 4}, {2, 4}, {1, 4}, {0, 4}}) {
+      board.move(kBlack, r, c, removed);
+    }
+    wq::LifeAndDeathSolver solver;
+    int64_t node_count = 0;
+    const auto start = Clock::now();
+    for (int i = 0; i < kSolveCount; ++i) {
+      const auto result = solver.solve(board, kBlack, kBlack, wq::Point(2, 0),
+                                       wq::Point(0, 0), wq::Point(4, 5));
+      if (result.status != wq::LifeAndDeathStatus::kDead) {
+        std::cerr << "life and death: wrong status" << std::endl;
+        std::exit(1);
+      }
+      node_count += result.node_count;
+    }
+    const std::chrono::duration<double> elapsed = Clock::now() - start;
+    std::cout << std::left << std::setw(28) << "life and death 19"
+              << std::right << std::setw(12) << std::setprecision(0)
+              << kSolveCount / elapsed.count() << " solves/s" << std::setw(8)
+              << node_count / elapsed.count() << " nodes/s" << std::endl;
+  }
+
+  // Whole random games of PlayoutEngine on one worker, as used for
+  // Monte-Carlo estimates.
+  wq::PlayoutEngine engine(1);
+  for (const int size : {9, 19}) {
+    constexpr int kEstimatePlayouts = 2000;
+    wq::Board board(size, size);
+    const auto start = Clock::now();
+    engine.estimate(board, kBlack, 7.5, kEstimatePlayouts);
+    const std::chrono::duration<double> elapsed = Clock::now() - start;
+    std::cout << std::left << std::setw(28)
+              << "playout engine " + std::to_string(size) << std::right
+              << std::setw(12) << std::setprecision(0)
+              << kEstimatePlayouts / elapsed.count() << " playouts/s"
+              << std::endl;
+  }
+
+  return 0;
+}
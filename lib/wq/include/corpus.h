@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "sgf.h"
+#include "wq.h"
+
+namespace wq {
+
+// Binary file of game records, meant to be opened in place. All integers are
+// little-endian.
+//
+//   header   "WQCORPUS", u32 version, u32 reserved, u64 game count,
+//            u64 offset of the index
+//   games    one record per game, back to back
+//   index    u64 offset of every record
+//
+// A record holds the board size as two bytes, then as varints the komi in
+// half points (zigzag encoded), the winner (0 unknown, 1 black, 2 white), and
+// the count and byte length of the setup stones and of the moves, followed
+// by both streams. Every stone or move is a varint of twice the point index
+// r * col_count + c, plus one for white; row_count * col_count is a pass.
+constexpr uint32_t kCorpusVersion = 1;
+
+// Stones or moves of a record, decoded while iterating. A truncated varint or
+// a code off the board, including a pass among setup stones, ends the
+// iteration early; decode() reports it.
+class CorpusMoves {
+ public:
+  class Iterator {
+   public:
+    Iterator(const uint8_t *p, const uint8_t *end, int row_count,
+             int col_count, bool passes);
+    Move operator*() const;
+    Iterator &operator++();
+    bool operator==(const Iterator &o) const { return p_ == o.p_; }
+    bool operator!=(const Iterator &o) const { return p_ != o.p_; }
+
+   private:
+    const uint8_t *p_;
+    const uint8_t *end_;
+    int row_count_;
+    int col_count_;
+    bool passes_;
+    // Varint under p_ and its length.
+    uint64_t code_ = 0;
+    int code_size_ = 0;
+
+    void decode();
+  };
+
+  CorpusMoves() = default;
+  // passes tells whether the stream may hold passes, as moves do and setup
+  // stones do not.
+  CorpusMoves(const uint8_t *begin, const uint8_t *end, int64_t count,
+              int row_count, int col_count, bool passes);
+  Iterator begin() const;
+  Iterator end() const;
+  int64_t size() const { return count_; }
+  // Decodes every move into out, reusing its capacity. Returns false if the
+  // stream is corrupt: it ends early or holds more moves than size().
+  bool decode(MoveList &out) const;
+
+ private:
+  const uint8_t *begin_ = nullptr;
+  const uint8_t *end_ = nullptr;
+  int64_t count_ = 0;
+  int row_count_ = 0;
+  int col_count_ = 0;
+  bool passes_ = false;
+};
+
+// Record of a game inside an open CorpusReader, valid as long as it is.
+struct CorpusGame {
+  int row_count = 0;
+  int col_count = 0;
+  double komi = 0;
+  Color winner = Color::kNone;
+  CorpusMoves setup;
+  CorpusMoves moves;
+};
+
+// Writes a corpus file. Records are streamed to the file as they are added
+// and the index is kept in memory until close().
+class CorpusWriter {
+ public:
+  explicit CorpusWriter(const char *path);
+  ~CorpusWriter();
+  CorpusWriter(const CorpusWriter &) = delete;
+  CorpusWriter &operator=(const CorpusWriter &) = delete;
+
+  // False once the file could not be opened or a write failed. Later calls
+  // to add() do nothing.
+  bool ok() const;
+  // Adds the main line of a game. The winner is taken from the first
+  // letter of the result; player names and dates are not kept.
+  void add(const SgfGame &game);
+  // Writes the index and header. Returns false, without writing them, if
+  // opening or any write failed.
+  bool close();
+
+ private:
+  std::ofstream out_;
+  std::vector<uint64_t> offsets_;
+  std::vector<uint8_t> record_;
+  std::vector<uint8_t> setup_;
+  std::vector<uint8_t> moves_;
+  bool closed_ = false;
+};
+
+// Opens a corpus file by mapping it into memory, so that opening costs the
+// same for any number of games and records are only read when visited.
+class CorpusReader {
+ public:
+  CorpusReader() = default;
+  ~CorpusReader();
+  CorpusReader(const CorpusReader &) = delete;
+  CorpusReader &operator=(const CorpusReader &) = delete;
+
+  // Returns false with a message in error() if the file cannot be mapped or
+  // its header and index do not fit in it.
+  bool open(const char *path);
+  void close();
+  int64_t size() const;
+  // Record of the i-th game, or nothing if it is corrupt.
+  std::optional<CorpusGame> game(int64_t i) const;
+  const std::string &error() const;
+
+ private:
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+  int64_t game_count_ = 0;
+  uint64_t index_offset_ = 0;
+  std::string error_;
+#ifdef _WIN32
+  // Windows builds read the whole file instead of mapping it.
+  std::vector<uint8_t> buffer_;
+#endif
+
+  bool fail(const std::string &message);
+};
+
+}  // namespace wq
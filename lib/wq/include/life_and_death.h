@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "wq.h"
+
+namespace wq {
+
+enum class LifeAndDeathStatus {
+  kUnknown = 0,
+  // The attacker can capture the target chain.
+  kDead = 1,
+  // The defender can keep the target chain on the board.
+  kAlive = 2,
+};
+
+struct LifeAndDeathResult {
+  LifeAndDeathStatus status = LifeAndDeathStatus::kUnknown;
+  // Move for the side to play that achieves the status, or kPass if the
+  // defender can afford to pass. Empty when the side to play loses or the
+  // search ran out of nodes.
+  std::optional<Point> move;
+  int64_t node_count = 0;
+};
+
+// Depth-first proof-number search of a local life-and-death problem. Both
+// sides play inside a rectangular region, corners included, on the empty
+// points the target chain can reach without crossing attacker stones and on
+// the liberties of attacker chains around them with at most two liberties.
+// The defender may also pass. The attacker wins by capturing the target chain
+// and the defender wins when the target becomes unconditionally alive
+// (Benson) or the attacker runs out of moves, as in seki.
+//
+// Searched positions go into a transposition table keyed by the Zobrist hash
+// of the board and the side to move, whose size is fixed by the memory cap.
+// The table ignores the move history, so superko is only enforced along the
+// current line.
+class LifeAndDeathSolver {
+ public:
+  explicit LifeAndDeathSolver(size_t max_memory_bytes = size_t(64) << 20,
+                              int64_t max_nodes = 1000000);
+
+  // Solves the problem with to_move to play, where target is a stone of the
+  // defender inside the region. The board is used as scratch space and left
+  // unchanged. The status is kUnknown if more than max_nodes positions had to
+  // be expanded.
+  LifeAndDeathResult solve(Board &board, Color to_move, Color attacker,
+                           Point target, Point top_left, Point bottom_right);
+
+  // Solves the problem after to_move plays first, which may be kPass for the
+  // defender. The status is kUnknown if first is illegal.
+  LifeAndDeathResult solve_move(Board &board, Color to_move, Point first,
+                                Color attacker, Point target, Point top_left,
+                                Point bottom_right);
+
+  // Largest chain of defender inside the region, as the point of one of its
+  // stones.
+  static std::optional<Point> find_target(const Board &board, Color defender,
+                                          Point top_left, Point bottom_right);
+
+ private:
+  struct Entry {
+    uint64_t key = 0;
+    uint32_t pn = 0;
+    uint32_t dn = 0;
+    // Nodes expanded below the entry.
+    uint32_t work = 0;
+    // Call of solve() that stored the entry; older entries count as empty.
+    uint32_t generation = 0;
+  };
+
+  struct Child {
+    Point p;
+    uint32_t pn;
+    uint32_t dn;
+  };
+
+  const int64_t max_nodes_;
+  std::vector<Entry> table_;
+  uint32_t generation_ = 0;
+  int64_t node_count_ = 0;
+
+  // Problem being solved.
+  Board *board_ = nullptr;
+  Color attacker_ = Color::kNone;
+  Color defender_ = Color::kNone;
+  Point target_;
+  Point top_left_;
+  Point bottom_right_;
+
+  // Children of the nodes on the current line, indexed by depth.
+  std::vector<std::vector<Child>> children_;
+  PointList removed_;
+  PointList added_;
+
+  // Points worth playing in the current position, and scratch space to find
+  // them, indexed by r * col_count + c.
+  std::vector<int> candidates_;
+  std::vector<int> wall_;
+  std::vector<int> libs_;
+  std::vector<uint64_t> mark_;
+  std::vector<uint64_t> candidate_;
+  uint64_t tag_ = 0;
+
+  // Scratch space of the Benson check, indexed by r * col_count + c.
+  std::vector<Color> stones_;
+  std::vector<int> chain_id_;
+  std::vector<int> region_id_;
+  std::vector<int> stack_;
+  std::vector<int> region_points_;
+  std::vector<int> lib_count_;
+  std::vector<int> touched_;
+  std::vector<int> region_begin_;
+  std::vector<int> region_chains_;
+  std::vector<bool> region_vital_;
+  std::vector<bool> chain_alive_;
+  std::vector<bool> region_healthy_;
+
+  uint64_t key(Color to_move) const;
+  const Entry *lookup(uint64_t key) const;
+  void store(uint64_t key, uint32_t pn, uint32_t dn, int64_t work);
+  bool captured() const;
+  bool pass_alive();
+  void find_candidates();
+  void expand(int depth, Color to_move);
+  void evaluate_child(Color to_move, Child &child) const;
+  void mid(int depth, Color to_move, uint32_t th_pn, uint32_t th_dn,
+           uint32_t &pn, uint32_t &dn);
+};
+
+}  // namespace wq
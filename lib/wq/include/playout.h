@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "score.h"
+#include "wq.h"
+
+namespace wq {
+
+// Estimate of a position averaged over random playouts.
+struct PlayoutEstimate {
+  int row_count = 0;
+  int col_count = 0;
+  int playout_count = 0;
+  // Mean owner of every point at the end of the playouts, from -1 (white) to
+  // 1 (black), indexed by r * col_count + c.
+  std::vector<double> ownership;
+  // Fraction of playouts won by black, draws counting as half a win.
+  double black_win_rate = 0;
+  // Mean area score of black minus white, komi included.
+  double score_lead = 0;
+};
+
+// Evaluates positions by playing uniformly random legal moves that do not
+// fill the player's own eyes until both sides pass, and counting the result
+// with area scoring. Playouts run on a pool of worker threads, each with its
+// own random generator.
+class PlayoutEngine {
+ public:
+  // Starts thread_count workers, or one per hardware thread if 0.
+  explicit PlayoutEngine(int thread_count = 0, uint64_t seed = 1);
+  ~PlayoutEngine();
+  PlayoutEngine(const PlayoutEngine &) = delete;
+  PlayoutEngine &operator=(const PlayoutEngine &) = delete;
+
+  // Runs playout_count playouts from board with to_move to play, and blocks
+  // until all of them are done. The board is not modified.
+  PlayoutEstimate estimate(const Board &board, Color to_move, double komi,
+                           int playout_count);
+
+  // Plays one random game from the current position of board, leaving the
+  // final position on it, and returns its area score. Games are cut after
+  // three times as many moves as the board has points.
+  static Score playout(Board &board, Color to_move, std::mt19937_64 &gen);
+
+ private:
+  std::vector<std::thread> workers_;
+  // Serializes calls to estimate().
+  std::mutex estimate_mu_;
+
+  // Current job, guarded by mu_. Workers wait on work_cv_ for a new
+  // generation and the caller waits on done_cv_ for busy_ to drop to zero.
+  std::mutex mu_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  uint64_t generation_ = 0;
+  bool stop_ = false;
+  int busy_ = 0;
+  const Board *board_ = nullptr;
+  Color to_move_ = Color::kBlack;
+  double komi_ = 0;
+  int playout_count_ = 0;
+  std::atomic<int> next_playout_{0};
+  PlayoutEstimate result_;
+
+  void worker(uint64_t seed);
+};
+
+}  // namespace wq
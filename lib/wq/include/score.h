@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+
+#include "wq.h"
+
+namespace wq {
+
+// Result of counting a position. Points are indexed by r * col_count + c.
+struct Score {
+  int row_count = 0;
+  int col_count = 0;
+  // Colour each point is counted for: live stones, and the empty points and
+  // dead stones of regions bordered by a single colour. Neutral points hold
+  // kNone.
+  std::vector<Color> owner;
+  int black = 0;
+  int white = 0;
+
+  Color owner_at(int r, int c) const { return owner[r * col_count + c]; }
+};
+
+// Counts with Tromp-Taylor area rules: every stone scores for its colour and
+// every empty region scores for the colour of the stones around it, provided
+// it only touches one colour. Stones marked in dead are taken off the board
+// first; dead may be empty if all stones are alive.
+Score area_score(int row_count, int col_count, const std::vector<Color> &stones,
+                 const std::vector<bool> &dead = {});
+
+// Counts with territory rules: the empty points and dead stones of a region
+// bordered by a single colour score for it, and every dead stone scores once
+// more as a prisoner. Prisoners taken during the game are not included.
+Score territory_score(int row_count, int col_count,
+                      const std::vector<Color> &stones,
+                      const std::vector<bool> &dead = {});
+
+// Stones of a board, indexed by r * col_count() + c.
+template <class B>
+std::vector<Color> board_stones(const B &board) {
+  std::vector<Color> stones(board.row_count() * board.col_count());
+  for (int r = 0; r < board.row_count(); ++r) {
+    for (int c = 0; c < board.col_count(); ++c) {
+      stones[r * board.col_count() + c] = board.at(r, c);
+    }
+  }
+  return stones;
+}
+
+}  // namespace wq
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "wq.h"
+
+namespace wq {
+
+enum class SgfToken {
+  kEnd = 0,
+  kError = 1,
+  // '(' opening a game tree.
+  kTreeBegin = 2,
+  // ')' closing a game tree.
+  kTreeEnd = 3,
+  // ';' starting a node.
+  kNode = 4,
+  // One value of a property. Every value of a list such as AB[aa][bb] is a
+  // separate token with the same property identifier.
+  kValue = 5,
+};
+
+// Splits SGF text into tokens without copying it: identifiers and values are
+// views into the text, so it must outlive them.
+class SgfTokenizer {
+ public:
+  explicit SgfTokenizer(std::string_view text);
+
+  SgfToken next();
+  // Identifier of the property the last kValue belongs to.
+  std::string_view property_id() const;
+  // Last kValue, as the raw text between the brackets with escapes left in.
+  std::string_view value() const;
+  // Offset of the first character not read yet, or of the error.
+  size_t offset() const;
+  // Reason of the last kError.
+  const char *error() const;
+
+ private:
+  std::string_view text_;
+  size_t pos_ = 0;
+  std::string_view property_id_;
+  std::string_view value_;
+  const char *error_ = "";
+};
+
+// Main line of a game record.
+struct SgfGame {
+  int row_count = 19;
+  int col_count = 19;
+  double komi = 0;
+  int handicap = 0;
+  // Text properties PB, PW, DT and RE, unescaped.
+  std::string black_player;
+  std::string white_player;
+  std::string date;
+  std::string result;
+  // Stones added before the first move (AB and AW).
+  MoveList setup;
+  // Moves of the main line, with kPass for passes.
+  MoveList moves;
+
+  // Resets every field, keeping the allocated capacity.
+  void clear();
+};
+
+// Reads the game trees of a collection one at a time. Only the properties of
+// SgfGame are decoded and variations are skipped by counting parentheses, so
+// reading allocates nothing once the fields of the game have grown to fit.
+class SgfReader {
+ public:
+  // The text must outlive the reader.
+  explicit SgfReader(std::string_view text);
+
+  // Reads the main line of the next game tree into game. Games that cannot
+  // be read, such as non-Go games or moves outside the board, are skipped and
+  // counted in error_count(). Returns false after the last game or if the
+  // text is malformed.
+  bool next(SgfGame &game);
+  int64_t error_count() const;
+  // Description of the last skipped game or syntax error, with its offset.
+  const std::string &error() const;
+
+ private:
+  SgfTokenizer tokenizer_;
+  int64_t error_count_ = 0;
+  std::string error_;
+
+  // Reads the tree whose '(' was just read. Returns false if it has to be
+  // skipped; the tokenizer is then left after its ')' unless the text is
+  // malformed.
+  bool read_tree(SgfGame &game);
+  bool fail(const char *message);
+};
+
+// Appends the unescaped form of a raw SGF text value to out: escaped
+// characters lose their backslash and escaped line breaks are removed.
+void sgf_unescape(std::string_view raw, std::string &out);
+
+// Appends text to out escaped to go between brackets.
+void sgf_escape(std::string_view text, std::string &out);
+
+// Appends the game to out as an SGF game tree, so that calls on the same
+// string build a collection.
+void write_sgf(const SgfGame &game, std::string &out);
+
+}  // namespace wq
@@ -1,9 +1,8 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <optional>
-#include <stack>
-#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -25,33 +24,273 @@ using MoveList = std::vector<Move>;
 
 constexpr Point kPass{-1, -1};
 
+// Largest number of rows and columns a board can have.
+constexpr int kMaxBoardSize = 25;
+
+// Position hash made of the Zobrist hashes of two independent tables, for
+// uses where 64-bit collisions matter, such as large transposition tables.
+struct Hash128 {
+  uint64_t lo = 0;
+  uint64_t hi = 0;
+
+  bool operator==(const Hash128 &o) const { return lo == o.lo && hi == o.hi; }
+  bool operator!=(const Hash128 &o) const { return !(*this == o); }
+};
+
+// Key to mix into a position hash when white is to play.
+Hash128 white_to_move_key();
+
+// Outcome of checking a move against the rules.
+enum class MoveStatus {
+  kLegal = 0,
+  kOutside = 1,
+  kOccupied = 2,
+  kSuicide = 3,
+  // The move would repeat an earlier position forbidden by the ko rule.
+  kRepetition = 4,
+};
+
+// Positions a move may not repeat.
+enum class KoRule {
+  // The position before the opponent's last move, which only forbids
+  // retaking a ko at once. A pass in between lifts the ban.
+  kSimple = 0,
+  // Any earlier position.
+  kPositionalSuperko = 1,
+  // Any earlier position with the same player to move, so a pass creates a
+  // new situation.
+  kSituationalSuperko = 2,
+};
+
+// Symmetries of the board, numbered 0 to kSymmetryCount - 1: bit 0 flips
+// the rows, bit 1 flips the columns and bit 2 then transposes the board,
+// which only applies to square boards. Symmetry 0 is the identity.
+constexpr int kSymmetryCount = 8;
+
+// Image of p under a symmetry of a row_count x col_count board.
+Point symmetry_transform(Point p, int symmetry, int row_count, int col_count);
+
+// Symmetry that undoes the given one.
+int inverse_symmetry(int symmetry);
+
+// Position hash that is the same for all positions related by a symmetry of
+// the board and, optionally, by swapping the colours of the stones.
+struct CanonicalHash {
+  uint64_t hash = 0;
+  // Transformation taking the board to the position the hash belongs to.
+  int symmetry = 0;
+  bool swap_colors = false;
+};
+
+// Set of position hashes seen so far, used to enforce superko. It uses open
+// addressing with linear probing in a single array, and erases by shifting
+// back the following entries, so insert, lookup and erase are O(1) on average
+// and only allocate when the table grows.
+class PositionSet {
+ public:
+  explicit PositionSet(size_t expected_size);
+  bool contains(uint64_t h) const;
+  bool insert(uint64_t h);
+  bool erase(uint64_t h);
+  size_t size() const;
+
+ private:
+  // Slots hold 0 when empty, so the zero hash is tracked separately.
+  std::vector<uint64_t> slots_;
+  size_t size_ = 0;
+  bool has_zero_ = false;
+
+  size_t slot(uint64_t h) const;
+  void grow();
+};
+
+// Board of any size up to kMaxBoardSize x kMaxBoardSize, as used by the
+// editor, the game windows and task replay.
 class Board {
  public:
-  Board(int row_count, int col_count);
+  // Copy of the full position and move history. Taking and restoring one
+  // only copies flat arrays, so callers can keep checkpoints instead of
+  // replaying moves.
+  struct Snapshot {
+    int row_count = 0;
+    int col_count = 0;
+    std::vector<Color> state;
+    std::vector<int> chain;
+    std::vector<int> next;
+    std::vector<int> chain_size;
+    std::vector<int> chain_libs;
+    uint64_t hash = 0;
+    uint64_t hash_hi = 0;
+    KoRule ko_rule = KoRule::kPositionalSuperko;
+    PositionSet prev_hash{0};
+    std::vector<Move> prev_move;
+    PointList prev_removed;
+    std::vector<size_t> prev_removed_begin;
+    std::vector<uint64_t> prev_move_hash;
+    std::vector<bool> prev_inserted;
+  };
+
+  Board(int row_count, int col_count,
+        KoRule ko_rule = KoRule::kPositionalSuperko);
   int row_count() const;
   int col_count() const;
+  KoRule ko_rule() const;
   Color at(int r, int c) const;
+  // Last move or pass, whose point is then kPass.
   std::optional<Move> last_move() const;
+  // Zobrist hash of the stones on the board.
+  uint64_t hash() const;
+  // hash() with white_to_move_key() mixed in if to_move is white, which tells
+  // apart the situations compared by situational superko.
+  uint64_t situation_hash(Color to_move) const;
+  // 128-bit hash of the stones on the board, whose low half is hash().
+  Hash128 hash128() const;
+  // Zobrist hash of the board transformed by a symmetry and optionally with
+  // the colours swapped, computed from the stones without moving them.
+  // symmetry_hash(0, false) equals hash().
+  uint64_t symmetry_hash(int symmetry, bool swap_colors) const;
+  // Smallest hash over the symmetries of the board, with colours swapped if
+  // swap_colors is set. Non-square boards only have four symmetries.
+  CanonicalHash canonical_hash(bool swap_colors = true) const;
   bool move(Color col, int r, int c, PointList &removed);
+  // Records a pass by col in O(1). It leaves the stones alone but counts as
+  // a move for the ko rule and for undo().
+  void pass(Color col);
+  // Takes back the last move or pass. For a pass (r_out, c_out) is kPass and
+  // added is empty.
   bool undo(int &r_out, int &c_out, PointList &added);
+  // Checks a move by col at (r, c) without playing it.
+  MoveStatus move_status(Color col, int r, int c) const;
+  // Legality of a move by col on every point, indexed by r * col_count() + c.
+  // Each point is checked against the chain liberty counts without playing
+  // it, so the whole mask costs about as much as a single pass over the
+  // board.
+  std::vector<bool> legal_moves(Color col) const;
+  void legal_moves(Color col, std::vector<bool> &out) const;
+  // Reads whether the chain at (r, c) can be captured in a ladder. If the
+  // chain is in atari its owner moves first, if it has two liberties the
+  // opponent does. The defender may extend or capture a neighbouring chain in
+  // atari, and the attacker ataris on either liberty. On success line holds
+  // a capturing sequence. The search is iterative, uses the board itself as
+  // scratch space and leaves it unchanged; once its buffers have grown it
+  // does not allocate.
+  bool ladder_capture(int r, int c, MoveList &line);
+  Snapshot snapshot() const;
+  void snapshot(Snapshot &out) const;
+  // Restores a snapshot taken from a board of the same size and ko rule.
+  void restore(const Snapshot &s);
 
   static const wq::PointList &star_points(int board_size);
 
  private:
+  // Points are stored row-major in a flat array surrounded by a one-point
+  // border of sentinels, so neighbours can be visited without bounds checks.
   const int row_count_;
   const int col_count_;
-  std::vector<std::vector<Color>> state_;
+  const int stride_;
+  const std::array<int, 4> delta_;
+  std::vector<Color> state_;
   uint64_t traversal_tag_ = 0;
-  std::vector<std::vector<uint64_t>> tag_;
+  std::vector<uint64_t> tag_;
+  // Stones are grouped in chains kept as circular lists through next_. Each
+  // stone points to the head of its chain, and the head holds the chain size
+  // and its pseudo-liberty count (empty neighbours counted once per adjacent
+  // stone), which drops to zero exactly when the chain has no liberties.
+  std::vector<int> chain_;
+  std::vector<int> next_;
+  std::vector<int> chain_size_;
+  std::vector<int> chain_libs_;
+  // Scratch stack for chain traversals; every point is pushed at most once.
+  std::vector<int> stack_;
   uint64_t cur_hash_ = 0;
-  std::unordered_set<uint64_t> prev_hash_;
-  std::stack<Move, std::vector<Move>> prev_move_;
-  std::stack<PointList, std::vector<PointList>> prev_removed_;
+  // High half of the 128-bit hash, from the second Zobrist table.
+  uint64_t cur_hash_hi_ = 0;
+  const KoRule ko_rule_;
+  // Positions the ko rule forbids repeating: hashes for positional superko,
+  // situation hashes for situational superko, and unused for simple ko.
+  PositionSet prev_hash_;
+  // Moves and passes played, in order.
+  std::vector<Move> prev_move_;
+  // Stones captured by each move, concatenated. prev_removed_begin_ holds the
+  // offset where the stones of each move in prev_move_ start.
+  PointList prev_removed_;
+  std::vector<size_t> prev_removed_begin_;
+  // For each entry of prev_move_, the hash before it was played and whether
+  // it added a key to prev_hash_ that undo() must erase.
+  std::vector<uint64_t> prev_move_hash_;
+  std::vector<bool> prev_inserted_;
+
+  // Node of the ladder search: the moves left to try and the one on the
+  // board, if any.
+  struct LadderFrame {
+    static constexpr int kMaxMoves = 8;
+    std::array<int, kMaxMoves> moves;
+    int move_count = 0;
+    int next = 0;
+    int played = -1;
+    int legal_count = 0;
+    bool attacker = false;
+  };
+  std::vector<LadderFrame> ladder_stack_;
+  PointList ladder_points_;
 
   bool inside(int r, int c) const;
-  bool has_liberties(int r, int c);
-  uint64_t hash_group(wq::Color col, int r, int c);
-  void remove_group(int r, int c, PointList &removed);
+  int index(int r, int c) const;
+  Point point(int p) const;
+  uint64_t zobrist(int p, Color col) const;
+  uint64_t zobrist_hi(int p, Color col) const;
+  // Key of prev_hash_ for the position with stones hashing to h and to_move
+  // to play.
+  uint64_t ko_key(uint64_t h, Color to_move) const;
+  // Checks whether col can play at the point p. If it can, it returns the
+  // chains that would be captured and the hash of the resulting position.
+  MoveStatus check_move(int p, Color col, std::array<int, 4> &cap_chains,
+                        int &cap_chain_count, uint64_t &new_hash) const;
+  int adjacent_count(int p, int head) const;
+  void place_stone(int p, Color col);
+  void merge_chains(int a, int b);
+  void rebuild_chain(int p);
+  uint64_t hash_group(int head) const;
+  void remove_group(int head, PointList &removed);
+  int chain_liberties(int p, int *libs, int max_count);
+  void push_ladder_defence(int target, Color defender);
+  void record_ladder_line(Color defender, int capture, MoveList &line) const;
+};
+
+// Board for 19x19 games keeping black and white stones as bit masks, with
+// groups and liberties computed by shift-and-mask dilation. It follows the
+// same rules as a Board with positional superko.
+class BitBoard {
+ public:
+  static constexpr int kSize = 19;
+
+  BitBoard();
+  int row_count() const;
+  int col_count() const;
+  Color at(int r, int c) const;
+  std::optional<Move> last_move() const;
+  bool move(Color col, int r, int c, PointList &removed);
+  bool undo(int &r_out, int &c_out, PointList &added);
+
+  // Point (r, c) is stored at bit r * kSize + c.
+  struct Bits {
+    static constexpr int kWords = (kSize * kSize + 63) / 64;
+    std::array<uint64_t, kWords> w;
+  };
+
+ private:
+  struct State {
+    Bits black;
+    Bits white;
+    uint64_t hash;
+    Move move;
+  };
+
+  Bits black_{};
+  Bits white_{};
+  uint64_t cur_hash_ = 0;
+  PositionSet prev_hash_;
+  std::vector<State> prev_state_;
 };
 
 }  // namespace wq
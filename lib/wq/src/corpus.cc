@@ -0,0 +1,307 @@
+#include "corpus.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace wq {
+
+static constexpr char kMagic[8] = {'W', 'Q', 'C', 'O', 'R', 'P', 'U', 'S'};
+static constexpr size_t kHeaderSize = 32;
+
+static void put_u32(uint32_t v, uint8_t *out) {
+  for (int i = 0; i < 4; ++i) out[i] = uint8_t(v >> (8 * i));
+}
+
+static void put_u64(uint64_t v, uint8_t *out) {
+  for (int i = 0; i < 8; ++i) out[i] = uint8_t(v >> (8 * i));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+  uint32_t v = 0;
+  for (int i = 0; i < 4; ++i) v |= uint32_t(p[i]) << (8 * i);
+  return v;
+}
+
+static uint64_t get_u64(const uint8_t *p) {
+  uint64_t v = 0;
+  for (int i = 0; i < 8; ++i) v |= uint64_t(p[i]) << (8 * i);
+  return v;
+}
+
+static void put_varint(uint64_t v, std::vector<uint8_t> &out) {
+  while (v >= 0x80) {
+    out.push_back(uint8_t(v) | 0x80);
+    v >>= 7;
+  }
+  out.push_back(uint8_t(v));
+}
+
+// Reads a varint at p, not going past end. Returns its length, or 0 if it
+// is truncated or too long.
+static int get_varint(const uint8_t *p, const uint8_t *end, uint64_t &v) {
+  v = 0;
+  for (int i = 0; i < 10 && p + i < end; ++i) {
+    v |= uint64_t(p[i] & 0x7f) << (7 * i);
+    if (!(p[i] & 0x80)) return i + 1;
+  }
+  return 0;
+}
+
+static uint64_t move_code(const Move &m, int row_count, int col_count) {
+  const auto &[col, p] = m;
+  const uint64_t index = p == kPass ? uint64_t(row_count) * col_count
+                                    : uint64_t(p.first) * col_count + p.second;
+  return 2 * index + (col == Color::kWhite ? 1 : 0);
+}
+
+CorpusMoves::Iterator::Iterator(const uint8_t *p, const uint8_t *end,
+                                int row_count, int col_count, bool passes)
+    : p_(p),
+      end_(end),
+      row_count_(row_count),
+      col_count_(col_count),
+      passes_(passes) {
+  decode();
+}
+
+Move CorpusMoves::Iterator::operator*() const {
+  const Color col = code_ & 1 ? Color::kWhite : Color::kBlack;
+  const uint64_t index = code_ >> 1;
+  if (index == uint64_t(row_count_) * col_count_) return Move(col, kPass);
+  return Move(col, Point(int(index / col_count_), int(index % col_count_)));
+}
+
+CorpusMoves::Iterator &CorpusMoves::Iterator::operator++() {
+  p_ += code_size_;
+  decode();
+  return *this;
+}
+
+void CorpusMoves::Iterator::decode() {
+  if (p_ == end_) return;
+  code_size_ = get_varint(p_, end_, code_);
+  // A truncated stream, or a point off the board that callers would index
+  // boards with, ends it early.
+  const uint64_t pass_index = uint64_t(row_count_) * col_count_;
+  const uint64_t index = code_ >> 1;
+  if (code_size_ == 0 || index > pass_index ||
+      (index == pass_index && !passes_)) {
+    p_ = end_;
+  }
+}
+
+CorpusMoves::CorpusMoves(const uint8_t *begin, const uint8_t *end,
+                         int64_t count, int row_count, int col_count,
+                         bool passes)
+    : begin_(begin),
+      end_(end),
+      count_(count),
+      row_count_(row_count),
+      col_count_(col_count),
+      passes_(passes) {}
+
+CorpusMoves::Iterator CorpusMoves::begin() const {
+  return Iterator(begin_, end_, row_count_, col_count_, passes_);
+}
+
+CorpusMoves::Iterator CorpusMoves::end() const {
+  return Iterator(end_, end_, row_count_, col_count_, passes_);
+}
+
+bool CorpusMoves::decode(MoveList &out) const {
+  out.clear();
+  for (const Move &m : *this) {
+    if (int64_t(out.size()) == count_) return false;
+    out.push_back(m);
+  }
+  return int64_t(out.size()) == count_;
+}
+
+CorpusWriter::CorpusWriter(const char *path)
+    : out_(path, std::ios::binary | std::ios::trunc) {
+  if (!out_) return;
+  const uint8_t header[kHeaderSize] = {};
+  out_.write((const char *)header, kHeaderSize);
+}
+
+CorpusWriter::~CorpusWriter() {
+  if (!closed_) close();
+}
+
+bool CorpusWriter::ok() const { return !out_.fail(); }
+
+void CorpusWriter::add(const SgfGame &game) {
+  if (!out_) return;
+  const int rows = game.row_count;
+  const int cols = game.col_count;
+  setup_.clear();
+  for (const Move &m : game.setup) put_varint(move_code(m, rows, cols), setup_);
+  moves_.clear();
+  for (const Move &m : game.moves) put_varint(move_code(m, rows, cols), moves_);
+
+  const int64_t half_points = int64_t(game.komi * 2);
+  Color winner = Color::kNone;
+  if (!game.result.empty() && game.result[0] == 'B') winner = Color::kBlack;
+  if (!game.result.empty() && game.result[0] == 'W') winner = Color::kWhite;
+
+  record_.clear();
+  record_.push_back(uint8_t(rows));
+  record_.push_back(uint8_t(cols));
+  put_varint((uint64_t(half_points) << 1) ^ uint64_t(half_points >> 63),
+             record_);
+  put_varint((int)winner, record_);
+  put_varint(game.setup.size(), record_);
+  put_varint(setup_.size(), record_);
+  put_varint(game.moves.size(), record_);
+  put_varint(moves_.size(), record_);
+  record_.insert(record_.end(), setup_.begin(), setup_.end());
+  record_.insert(record_.end(), moves_.begin(), moves_.end());
+
+  offsets_.push_back(out_.tellp());
+  out_.write((const char *)record_.data(), record_.size());
+}
+
+bool CorpusWriter::close() {
+  closed_ = true;
+  // Offsets taken from a failed stream are meaningless, so no index is
+  // written after a failure.
+  if (!out_) {
+    out_.close();
+    return false;
+  }
+  const uint64_t index_offset = out_.tellp();
+  uint8_t buf[8];
+  for (const uint64_t offset : offsets_) {
+    put_u64(offset, buf);
+    out_.write((const char *)buf, sizeof(buf));
+  }
+
+  uint8_t header[kHeaderSize] = {};
+  std::memcpy(header, kMagic, sizeof(kMagic));
+  put_u32(kCorpusVersion, header + 8);
+  put_u64(offsets_.size(), header + 16);
+  put_u64(index_offset, header + 24);
+  out_.seekp(0);
+  out_.write((const char *)header, kHeaderSize);
+  out_.close();
+  return !out_.fail();
+}
+
+CorpusReader::~CorpusReader() { close(); }
+
+bool CorpusReader::open(const char *path) {
+  close();
+  error_.clear();
+#ifdef _WIN32
+  std::ifstream in(path, std::ios::binary);
+  if (!in) return fail(std::string("cannot open ") + path);
+  buffer_.assign(std::istreambuf_iterator<char>(in),
+                 std::istreambuf_iterator<char>());
+  data_ = buffer_.data();
+  size_ = buffer_.size();
+#else
+  const int fd = ::open(path, O_RDONLY);
+  if (fd < 0) return fail(std::string("cannot open ") + path);
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    return fail(std::string("cannot stat ") + path);
+  }
+  size_ = st.st_size;
+  if (size_ > 0) {
+    void *p = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+      ::close(fd);
+      size_ = 0;
+      return fail(std::string("cannot map ") + path);
+    }
+    data_ = (const uint8_t *)p;
+  }
+  // The mapping stays valid after the descriptor is closed.
+  ::close(fd);
+#endif
+
+  if (size_ < kHeaderSize || std::memcmp(data_, kMagic, sizeof(kMagic)) != 0)
+    return fail("not a corpus file");
+  if (get_u32(data_ + 8) != kCorpusVersion)
+    return fail("unsupported corpus version");
+  const uint64_t count = get_u64(data_ + 16);
+  index_offset_ = get_u64(data_ + 24);
+  if (index_offset_ < kHeaderSize || index_offset_ > size_ ||
+      count > (size_ - index_offset_) / 8) {
+    return fail("corrupt corpus index");
+  }
+  game_count_ = count;
+  return true;
+}
+
+void CorpusReader::close() {
+#ifdef _WIN32
+  buffer_.clear();
+#else
+  if (data_) munmap((void *)data_, size_);
+#endif
+  data_ = nullptr;
+  size_ = 0;
+  game_count_ = 0;
+  index_offset_ = 0;
+}
+
+int64_t CorpusReader::size() const { return game_count_; }
+
+std::optional<CorpusGame> CorpusReader::game(int64_t i) const {
+  if (i < 0 || i >= game_count_) return {};
+  const uint64_t offset = get_u64(data_ + index_offset_ + 8 * i);
+  if (offset < kHeaderSize || offset >= index_offset_) return {};
+  const uint8_t *p = data_ + offset;
+  const uint8_t *const end = data_ + index_offset_;
+
+  CorpusGame game;
+  if (end - p < 2) return {};
+  game.row_count = p[0];
+  game.col_count = p[1];
+  if (game.row_count < 1 || game.row_count > kMaxBoardSize ||
+      game.col_count < 1 || game.col_count > kMaxBoardSize) {
+    return {};
+  }
+  p += 2;
+
+  uint64_t fields[6];
+  for (uint64_t &v : fields) {
+    const int n = get_varint(p, end, v);
+    if (n == 0) return {};
+    p += n;
+  }
+  const auto &[komi, winner, setup_count, setup_size, move_count, move_size] =
+      fields;
+  if (winner > 2 || setup_size > uint64_t(end - p) ||
+      move_size > uint64_t(end - p) - setup_size) {
+    return {};
+  }
+  game.komi = int64_t((komi >> 1) ^ -(komi & 1)) / 2.0;
+  game.winner = (Color)winner;
+  game.setup = CorpusMoves(p, p + setup_size, setup_count, game.row_count,
+                           game.col_count, /*passes=*/false);
+  p += setup_size;
+  game.moves = CorpusMoves(p, p + move_size, move_count, game.row_count,
+                           game.col_count, /*passes=*/true);
+  return game;
+}
+
+const std::string &CorpusReader::error() const { return error_; }
+
+bool CorpusReader::fail(const std::string &message) {
+  close();
+  error_ = message;
+  return false;
+}
+
+}  // namespace wq
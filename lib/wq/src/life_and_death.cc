@@ -0,0 +1,467 @@
+#include "life_and_death.h"
+
+#include <algorithm>
+
+namespace wq {
+
+// Proof and disproof numbers of a solved node; sums saturate at it.
+static constexpr uint32_t kInfinity = 1u << 30;
+
+static Color opponent(Color col) {
+  return col == Color::kBlack ? Color::kWhite : Color::kBlack;
+}
+
+static uint32_t saturated_sum(uint32_t a, uint32_t b) {
+  return std::min<uint64_t>(uint64_t(a) + b, kInfinity);
+}
+
+LifeAndDeathSolver::LifeAndDeathSolver(size_t max_memory_bytes,
+                                       int64_t max_nodes)
+    : max_nodes_(max_nodes) {
+  size_t size = 1;
+  while (2 * size * sizeof(Entry) <= max_memory_bytes) size *= 2;
+  table_.resize(size);
+}
+
+LifeAndDeathResult LifeAndDeathSolver::solve(Board &board, Color to_move,
+                                             Color attacker, Point target,
+                                             Point top_left,
+                                             Point bottom_right) {
+  board_ = &board;
+  attacker_ = attacker;
+  defender_ = opponent(attacker);
+  target_ = target;
+  top_left_ = top_left;
+  bottom_right_ = bottom_right;
+  node_count_ = 0;
+  generation_++;
+  mark_.assign(board.row_count() * board.col_count(), 0);
+  candidate_.assign(board.row_count() * board.col_count(), 0);
+  tag_ = 0;
+
+  LifeAndDeathResult result;
+  if (captured()) {
+    result.status = LifeAndDeathStatus::kDead;
+    return result;
+  }
+
+  uint32_t pn, dn;
+  mid(0, to_move, kInfinity, kInfinity, pn, dn);
+  result.node_count = node_count_;
+  if (pn != 0 && dn != 0) return result;
+  result.status =
+      pn == 0 ? LifeAndDeathStatus::kDead : LifeAndDeathStatus::kAlive;
+
+  // The side to play wins through a child that is solved its way.
+  const bool attacker_wins = pn == 0;
+  if (attacker_wins == (to_move == attacker_)) {
+    for (const Child &child : children_[0]) {
+      if ((attacker_wins ? child.pn : child.dn) == 0) {
+        result.move = child.p;
+        break;
+      }
+    }
+  }
+  return result;
+}
+
+LifeAndDeathResult LifeAndDeathSolver::solve_move(Board &board, Color to_move,
+                                                  Point first, Color attacker,
+                                                  Point target, Point top_left,
+                                                  Point bottom_right) {
+  if (first == kPass) {
+    if (to_move == attacker) return {};
+  } else if (!board.move(to_move, first.first, first.second, removed_)) {
+    return {};
+  }
+  LifeAndDeathResult result = solve(board, opponent(to_move), attacker, target,
+                                    top_left, bottom_right);
+  int r, c;
+  if (first != kPass) board.undo(r, c, added_);
+  return result;
+}
+
+std::optional<Point> LifeAndDeathSolver::find_target(const Board &board,
+                                                     Color defender,
+                                                     Point top_left,
+                                                     Point bottom_right) {
+  const int rows = board.row_count();
+  const int cols = board.col_count();
+  std::vector<bool> seen(rows * cols, false);
+  std::vector<int> stack;
+  std::optional<Point> best;
+  int best_size = 0;
+  for (int r = top_left.first; r <= bottom_right.first; ++r) {
+    for (int c = top_left.second; c <= bottom_right.second; ++c) {
+      if (board.at(r, c) != defender || seen[r * cols + c]) continue;
+      int size = 0;
+      seen[r * cols + c] = true;
+      stack.push_back(r * cols + c);
+      while (!stack.empty()) {
+        const int p = stack.back();
+        stack.pop_back();
+        size++;
+        const int pr = p / cols;
+        const int pc = p % cols;
+        const Point nbrs[4] = {
+            {pr - 1, pc}, {pr + 1, pc}, {pr, pc - 1}, {pr, pc + 1}};
+        for (const auto &[nr, nc] : nbrs) {
+          if (nr < 0 || nr >= rows || nc < 0 || nc >= cols) continue;
+          if (board.at(nr, nc) != defender || seen[nr * cols + nc]) continue;
+          seen[nr * cols + nc] = true;
+          stack.push_back(nr * cols + nc);
+        }
+      }
+      if (size > best_size) {
+        best_size = size;
+        best = Point(r, c);
+      }
+    }
+  }
+  return best;
+}
+
+uint64_t LifeAndDeathSolver::key(Color to_move) const {
+  return board_->hash() ^
+         (to_move == Color::kWhite ? white_to_move_key().lo : 0);
+}
+
+const LifeAndDeathSolver::Entry *LifeAndDeathSolver::lookup(
+    uint64_t key) const {
+  const Entry &e = table_[key & (table_.size() - 1)];
+  if (e.generation != generation_ || e.key != key) return nullptr;
+  return &e;
+}
+
+void LifeAndDeathSolver::store(uint64_t key, uint32_t pn, uint32_t dn,
+                               int64_t work) {
+  // Keep whichever entry took more work to compute, so that a full table
+  // drops the cheap positions near the leaves first.
+  Entry &e = table_[key & (table_.size() - 1)];
+  const uint32_t w = std::min<int64_t>(work, UINT32_MAX);
+  if (e.generation == generation_ && e.key != key && e.work > w) return;
+  e.key = key;
+  e.generation = generation_;
+  e.pn = pn;
+  e.dn = dn;
+  e.work = w;
+}
+
+bool LifeAndDeathSolver::captured() const {
+  return board_->at(target_.first, target_.second) != defender_;
+}
+
+bool LifeAndDeathSolver::pass_alive() {
+  const Board &board = *board_;
+  const int rows = board.row_count();
+  const int cols = board.col_count();
+  const int area = rows * cols;
+  const auto for_each_neighbour = [&](int p, auto &&f) {
+    const int r = p / cols;
+    const int c = p % cols;
+    if (r > 0) f(p - cols);
+    if (r + 1 < rows) f(p + cols);
+    if (c > 0) f(p - 1);
+    if (c + 1 < cols) f(p + 1);
+  };
+  stones_.resize(area);
+  for (int r = 0; r < rows; ++r) {
+    for (int c = 0; c < cols; ++c) stones_[r * cols + c] = board.at(r, c);
+  }
+  const auto at = [&](int p) { return stones_[p]; };
+
+  // Number the chains of the defender and the regions they enclose, which
+  // are the connected sets of the remaining points.
+  chain_id_.assign(area, -1);
+  region_id_.assign(area, -1);
+  int chain_count = 0;
+  int region_count = 0;
+  for (int p = 0; p < area; ++p) {
+    const bool own = at(p) == defender_;
+    std::vector<int> &id = own ? chain_id_ : region_id_;
+    if (id[p] >= 0) continue;
+    const int n = own ? chain_count++ : region_count++;
+    id[p] = n;
+    stack_.assign(1, p);
+    while (!stack_.empty()) {
+      const int q = stack_.back();
+      stack_.pop_back();
+      for_each_neighbour(q, [&](int m) {
+        if ((at(m) == defender_) == own && id[m] < 0) {
+          id[m] = n;
+          stack_.push_back(m);
+        }
+      });
+    }
+  }
+
+  // Group the points by region with a counting sort.
+  region_begin_.assign(region_count + 1, 0);
+  for (int p = 0; p < area; ++p) {
+    if (region_id_[p] >= 0) region_begin_[region_id_[p] + 1]++;
+  }
+  for (int region = 0; region < region_count; ++region) {
+    region_begin_[region + 1] += region_begin_[region];
+  }
+  region_points_.resize(region_begin_[region_count]);
+  for (int p = 0; p < area; ++p) {
+    if (region_id_[p] >= 0) region_points_[region_begin_[region_id_[p]]++] = p;
+  }
+  const std::vector<int> &region_points = region_points_;
+
+  // For every region, the chains bordering it and whether it is vital to
+  // them, that is, all its empty points are liberties of the chain.
+  lib_count_.assign(chain_count, -1);
+  region_begin_.clear();
+  region_chains_.clear();
+  region_vital_.clear();
+  for (size_t i = 0; i < region_points.size();) {
+    const int region = region_id_[region_points[i]];
+    region_begin_.push_back(region_chains_.size());
+    touched_.clear();
+    int empty_count = 0;
+    for (; i < region_points.size() && region_id_[region_points[i]] == region;
+         ++i) {
+      const int p = region_points[i];
+      const bool empty = at(p) == Color::kNone;
+      empty_count += empty;
+      // Neighbours of one point may belong to the same chain.
+      int seen[4];
+      int seen_count = 0;
+      for_each_neighbour(p, [&](int m) {
+        const int chain = chain_id_[m];
+        if (chain < 0 || std::count(seen, seen + seen_count, chain)) return;
+        seen[seen_count++] = chain;
+        if (lib_count_[chain] < 0) {
+          lib_count_[chain] = 0;
+          touched_.push_back(chain);
+        }
+        lib_count_[chain] += empty;
+      });
+    }
+    for (const int chain : touched_) {
+      region_chains_.push_back(chain);
+      region_vital_.push_back(lib_count_[chain] == empty_count);
+      lib_count_[chain] = -1;
+    }
+  }
+  region_begin_.push_back(region_chains_.size());
+
+  // Benson's algorithm: drop the chains with fewer than two vital healthy
+  // regions and the regions bordering a dropped chain, until nothing changes.
+  chain_alive_.assign(chain_count, true);
+  region_healthy_.assign(region_count, true);
+  for (bool changed = true; changed;) {
+    changed = false;
+    lib_count_.assign(chain_count, 0);
+    for (int region = 0; region < region_count; ++region) {
+      if (!region_healthy_[region]) continue;
+      for (int i = region_begin_[region]; i < region_begin_[region + 1]; ++i) {
+        if (region_vital_[i]) lib_count_[region_chains_[i]]++;
+      }
+    }
+    for (int chain = 0; chain < chain_count; ++chain) {
+      if (chain_alive_[chain] && lib_count_[chain] < 2) {
+        chain_alive_[chain] = false;
+        changed = true;
+      }
+    }
+    for (int region = 0; region < region_count; ++region) {
+      if (!region_healthy_[region]) continue;
+      for (int i = region_begin_[region]; i < region_begin_[region + 1]; ++i) {
+        if (!chain_alive_[region_chains_[i]]) {
+          region_healthy_[region] = false;
+          changed = true;
+          break;
+        }
+      }
+    }
+  }
+
+  return chain_alive_[chain_id_[target_.first * cols + target_.second]];
+}
+
+void LifeAndDeathSolver::find_candidates() {
+  const Board &board = *board_;
+  const int rows = board.row_count();
+  const int cols = board.col_count();
+  const auto in_region = [&](int r, int c) {
+    return top_left_.first <= r && r <= bottom_right_.first &&
+           top_left_.second <= c && c <= bottom_right_.second;
+  };
+  const auto for_each_neighbour = [&](int p, auto &&f) {
+    const int r = p / cols;
+    const int c = p % cols;
+    if (r > 0) f(p - cols);
+    if (r + 1 < rows) f(p + cols);
+    if (c > 0) f(p - 1);
+    if (c + 1 < cols) f(p + 1);
+  };
+  const auto at = [&](int p) { return board.at(p / cols, p % cols); };
+
+  // The area the target can reach without crossing attacker stones.
+  candidates_.clear();
+  wall_.clear();
+  const uint64_t area_tag = ++tag_;
+  const int start = target_.first * cols + target_.second;
+  mark_[start] = area_tag;
+  stack_.assign(1, start);
+  while (!stack_.empty()) {
+    const int p = stack_.back();
+    stack_.pop_back();
+    if (at(p) == Color::kNone) {
+      candidates_.push_back(p);
+      candidate_[p] = area_tag;
+    }
+    for_each_neighbour(p, [&](int n) {
+      if (mark_[n] == area_tag || !in_region(n / cols, n % cols)) return;
+      mark_[n] = area_tag;
+      if (at(n) == attacker_) {
+        wall_.push_back(n);
+      } else {
+        stack_.push_back(n);
+      }
+    });
+  }
+
+  // Liberties of the attacker chains around it that are short of liberties,
+  // where either side may need to play to save or capture them.
+  for (const int w : wall_) {
+    if (mark_[w] > area_tag) continue;
+    const uint64_t chain_tag = ++tag_;
+    libs_.clear();
+    mark_[w] = chain_tag;
+    stack_.assign(1, w);
+    while (!stack_.empty()) {
+      const int p = stack_.back();
+      stack_.pop_back();
+      for_each_neighbour(p, [&](int n) {
+        if (mark_[n] == chain_tag) return;
+        const Color col = at(n);
+        if (col == attacker_) {
+          mark_[n] = chain_tag;
+          stack_.push_back(n);
+        } else if (col == Color::kNone) {
+          mark_[n] = chain_tag;
+          libs_.push_back(n);
+        }
+      });
+    }
+    if (libs_.size() > 2) continue;
+    for (const int l : libs_) {
+      if (candidate_[l] != area_tag && in_region(l / cols, l % cols)) {
+        candidate_[l] = area_tag;
+        candidates_.push_back(l);
+      }
+    }
+  }
+}
+
+void LifeAndDeathSolver::expand(int depth, Color to_move) {
+  if ((int)children_.size() <= depth) children_.resize(depth + 1);
+  std::vector<Child> &children = children_[depth];
+  children.clear();
+  find_candidates();
+  const int cols = board_->col_count();
+  for (const int p : candidates_) {
+    const int r = p / cols;
+    const int c = p % cols;
+    if (!board_->move(to_move, r, c, removed_)) continue;
+    Child child{Point(r, c), 1, 1};
+    evaluate_child(to_move, child);
+    int ur, uc;
+    board_->undo(ur, uc, added_);
+    children.push_back(child);
+  }
+  if (to_move == defender_) {
+    Child child{kPass, 1, 1};
+    evaluate_child(to_move, child);
+    children.push_back(child);
+  }
+}
+
+void LifeAndDeathSolver::evaluate_child(Color to_move, Child &child) const {
+  if (captured()) {
+    child.pn = 0;
+    child.dn = kInfinity;
+  } else if (const Entry *e = lookup(key(opponent(to_move)))) {
+    child.pn = e->pn;
+    child.dn = e->dn;
+  }
+}
+
+void LifeAndDeathSolver::mid(int depth, Color to_move, uint32_t th_pn,
+                             uint32_t th_dn, uint32_t &pn, uint32_t &dn) {
+  node_count_++;
+  const int64_t start = node_count_;
+  const uint64_t k = key(to_move);
+  const bool attacker_node = to_move == attacker_;
+
+  // Defender nodes are not checked: a pass-alive defender passes and the
+  // attacker node below finds it.
+  if (attacker_node && pass_alive()) {
+    pn = kInfinity;
+    dn = 0;
+    store(k, pn, dn, 1);
+    return;
+  }
+
+  // The attacker needs one move that kills and the defender one that lives,
+  // so attacker nodes are OR nodes and defender nodes AND nodes of the proof
+  // that the target dies.
+  expand(depth, to_move);
+  while (true) {
+    const std::vector<Child> &children = children_[depth];
+    int best = -1;
+    uint32_t best_value = kInfinity + 1;
+    uint32_t second_value = kInfinity;
+    uint32_t min_value = kInfinity;
+    uint32_t sum = 0;
+    for (int i = 0; i < (int)children.size(); ++i) {
+      const uint32_t v = attacker_node ? children[i].pn : children[i].dn;
+      const uint32_t w = attacker_node ? children[i].dn : children[i].pn;
+      sum = saturated_sum(sum, w);
+      min_value = std::min(min_value, v);
+      if (v < best_value) {
+        second_value = best_value;
+        best_value = v;
+        best = i;
+      } else if (v < second_value) {
+        second_value = v;
+      }
+    }
+    // A side without moves loses; only the attacker can run out.
+    pn = attacker_node ? min_value : sum;
+    dn = attacker_node ? sum : min_value;
+    if (pn >= th_pn || dn >= th_dn || node_count_ >= max_nodes_) break;
+
+    // Search the most promising child until it falls a quarter behind the
+    // second best, so that the search does not keep switching between close
+    // children, or its parent goes over a threshold.
+    const Child child = children[best];
+    const uint32_t second = std::min(second_value, kInfinity - 1);
+    uint32_t child_th_pn, child_th_dn;
+    if (attacker_node) {
+      child_th_pn = std::min(th_pn, second + second / 4 + 1);
+      child_th_dn = th_dn >= kInfinity ? kInfinity : th_dn - dn + child.dn;
+    } else {
+      child_th_dn = std::min(th_dn, second + second / 4 + 1);
+      child_th_pn = th_pn >= kInfinity ? kInfinity : th_pn - pn + child.pn;
+    }
+    if (child.p != kPass) {
+      board_->move(to_move, child.p.first, child.p.second, removed_);
+    }
+    uint32_t child_pn, child_dn;
+    mid(depth + 1, opponent(to_move), child_th_pn, child_th_dn, child_pn,
+        child_dn);
+    if (child.p != kPass) {
+      int r, c;
+      board_->undo(r, c, added_);
+    }
+    children_[depth][best].pn = child_pn;
+    children_[depth][best].dn = child_dn;
+  }
+  store(k, pn, dn, node_count_ - start + 1);
+}
+
+}  // namespace wq
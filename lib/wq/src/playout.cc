@@ -0,0 +1,170 @@
+#include "playout.h"
+
+#include <algorithm>
+
+namespace wq {
+
+// Whether (r, c) is an eye of col: all its neighbours are stones of col and
+// enough of its diagonals are too, so that the opponent cannot break it.
+static bool is_eye(const Board &board, int r, int c, Color col) {
+  const int rows = board.row_count();
+  const int cols = board.col_count();
+  const auto inside = [&](int i, int j) {
+    return 0 <= i && i < rows && 0 <= j && j < cols;
+  };
+
+  constexpr int kNeighbours[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+  for (const auto &[dr, dc] : kNeighbours) {
+    if (inside(r + dr, c + dc) && board.at(r + dr, c + dc) != col) return false;
+  }
+
+  // On the edge a single bad diagonal makes the eye false, elsewhere it takes
+  // two.
+  constexpr int kDiagonals[4][2] = {{-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+  int bad = 0;
+  int outside = 0;
+  for (const auto &[dr, dc] : kDiagonals) {
+    if (!inside(r + dr, c + dc)) {
+      outside++;
+    } else {
+      const Color d = board.at(r + dr, c + dc);
+      if (d != col && d != Color::kNone) bad++;
+    }
+  }
+  return bad + (outside > 0 ? 1 : 0) < 2;
+}
+
+Score PlayoutEngine::playout(Board &board, Color to_move,
+                             std::mt19937_64 &gen) {
+  const int rows = board.row_count();
+  const int cols = board.col_count();
+
+  // Empty points, as r * cols + c. Points tried and rejected during a turn
+  // are swapped past the end of the candidate range.
+  std::vector<int> empty;
+  empty.reserve(rows * cols);
+  for (int r = 0; r < rows; ++r) {
+    for (int c = 0; c < cols; ++c) {
+      if (board.at(r, c) == Color::kNone) empty.push_back(r * cols + c);
+    }
+  }
+
+  PointList removed;
+  Color col = to_move;
+  int pass_count = 0;
+  const int max_moves = 3 * rows * cols;
+  for (int i = 0; i < max_moves && pass_count < 2; ++i) {
+    bool played = false;
+    for (size_t n = empty.size(); n > 0 && !played;) {
+      const size_t k = gen() % n;
+      const int r = empty[k] / cols;
+      const int c = empty[k] % cols;
+      if (!is_eye(board, r, c, col) && board.move(col, r, c, removed)) {
+        played = true;
+        empty[k] = empty.back();
+        empty.pop_back();
+        for (const auto &[rr, cc] : removed) empty.push_back(rr * cols + cc);
+      } else {
+        std::swap(empty[k], empty[--n]);
+      }
+    }
+    pass_count = played ? 0 : pass_count + 1;
+    col = col == Color::kBlack ? Color::kWhite : Color::kBlack;
+  }
+
+  return area_score(rows, cols, board_stones(board));
+}
+
+PlayoutEngine::PlayoutEngine(int thread_count, uint64_t seed) {
+  if (thread_count <= 0)
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 0; i < thread_count; ++i) {
+    workers_.emplace_back(&PlayoutEngine::worker, this, seed + i);
+  }
+}
+
+PlayoutEngine::~PlayoutEngine() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stop_ = true;
+  }
+  work_cv_.notify_all();
+  for (auto &t : workers_) t.join();
+}
+
+PlayoutEstimate PlayoutEngine::estimate(const Board &board, Color to_move,
+                                        double komi, int playout_count) {
+  std::lock_guard<std::mutex> estimate_lock(estimate_mu_);
+  std::unique_lock<std::mutex> lock(mu_);
+  board_ = &board;
+  to_move_ = to_move;
+  komi_ = komi;
+  playout_count_ = playout_count;
+  next_playout_ = 0;
+  result_ = PlayoutEstimate();
+  result_.row_count = board.row_count();
+  result_.col_count = board.col_count();
+  result_.ownership.assign(board.row_count() * board.col_count(), 0);
+  busy_ = workers_.size();
+  generation_++;
+  work_cv_.notify_all();
+  done_cv_.wait(lock, [this] { return busy_ == 0; });
+  board_ = nullptr;
+
+  PlayoutEstimate ret = std::move(result_);
+  if (ret.playout_count > 0) {
+    for (double &v : ret.ownership) v /= ret.playout_count;
+    ret.black_win_rate /= ret.playout_count;
+    ret.score_lead /= ret.playout_count;
+  }
+  return ret;
+}
+
+void PlayoutEngine::worker(uint64_t seed) {
+  std::mt19937_64 gen(seed);
+  uint64_t seen_generation = 0;
+  std::vector<double> ownership;
+  while (true) {
+    std::unique_lock<std::mutex> lock(mu_);
+    work_cv_.wait(lock,
+                  [&] { return stop_ || generation_ != seen_generation; });
+    if (stop_) return;
+    seen_generation = generation_;
+    const Color to_move = to_move_;
+    const double komi = komi_;
+    const int playout_count = playout_count_;
+    lock.unlock();
+
+    // The caller keeps the board alive and untouched until every worker has
+    // reported back, so it can be copied without holding the lock.
+    Board board(*board_);
+    const Board::Snapshot start = board.snapshot();
+    ownership.assign(board.row_count() * board.col_count(), 0);
+    int count = 0;
+    double wins = 0;
+    double score_sum = 0;
+    while (next_playout_++ < playout_count) {
+      board.restore(start);
+      const Score score = playout(board, to_move, gen);
+      for (size_t i = 0; i < ownership.size(); ++i) {
+        if (score.owner[i] == Color::kBlack) ownership[i] += 1;
+        if (score.owner[i] == Color::kWhite) ownership[i] -= 1;
+      }
+      const double lead = score.black - score.white - komi;
+      wins += lead > 0 ? 1 : lead == 0 ? 0.5 : 0;
+      score_sum += lead;
+      count++;
+    }
+
+    lock.lock();
+    for (size_t i = 0; i < ownership.size(); ++i) {
+      result_.ownership[i] += ownership[i];
+    }
+    result_.playout_count += count;
+    result_.black_win_rate += wins;
+    result_.score_lead += score_sum;
+    if (--busy_ == 0) done_cv_.notify_one();
+  }
+}
+
+}  // namespace wq
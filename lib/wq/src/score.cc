@@ -0,0 +1,103 @@
+#include "score.h"
+
+#include <cassert>
+
+namespace wq {
+
+// Fills the owner of every point and returns it, flooding each empty region
+// once, so the whole board is scanned in linear time.
+static Score count_regions(int row_count, int col_count,
+                           const std::vector<Color> &stones,
+                           const std::vector<bool> &dead) {
+  const int size = row_count * col_count;
+  assert((int)stones.size() == size);
+  assert(dead.empty() || (int)dead.size() == size);
+
+  Score score;
+  score.row_count = row_count;
+  score.col_count = col_count;
+  score.owner.resize(size);
+
+  // Dead stones are counted as empty points of the surrounding region.
+  std::vector<Color> state(stones);
+  for (int i = 0; i < (int)dead.size(); ++i) {
+    if (dead[i]) state[i] = Color::kNone;
+  }
+
+  std::vector<bool> visited(size, false);
+  std::vector<int> region;
+  region.reserve(size);
+  for (int i = 0; i < size; ++i) {
+    if (state[i] != Color::kNone) {
+      score.owner[i] = state[i];
+      continue;
+    }
+    if (visited[i]) continue;
+
+    // Collect the region of i, noting which colours border it
+    bool reaches_black = false;
+    bool reaches_white = false;
+    region.clear();
+    region.push_back(i);
+    visited[i] = true;
+    for (size_t k = 0; k < region.size(); ++k) {
+      const int q = region[k];
+      const int r = q / col_count;
+      const int c = q % col_count;
+      const int neighbours[4][2] = {
+          {r - 1, c}, {r + 1, c}, {r, c - 1}, {r, c + 1}};
+      for (const auto &[nr, nc] : neighbours) {
+        if (nr < 0 || nr >= row_count || nc < 0 || nc >= col_count) continue;
+        const int n = nr * col_count + nc;
+        switch (state[n]) {
+          case Color::kNone:
+            if (!visited[n]) {
+              visited[n] = true;
+              region.push_back(n);
+            }
+            break;
+          case Color::kBlack:
+            reaches_black = true;
+            break;
+          case Color::kWhite:
+            reaches_white = true;
+            break;
+        }
+      }
+    }
+
+    Color owner = Color::kNone;
+    if (reaches_black && !reaches_white) owner = Color::kBlack;
+    if (reaches_white && !reaches_black) owner = Color::kWhite;
+    for (const int q : region) score.owner[q] = owner;
+  }
+  return score;
+}
+
+Score area_score(int row_count, int col_count, const std::vector<Color> &stones,
+                 const std::vector<bool> &dead) {
+  Score score = count_regions(row_count, col_count, stones, dead);
+  for (const Color owner : score.owner) {
+    if (owner == Color::kBlack) score.black++;
+    if (owner == Color::kWhite) score.white++;
+  }
+  return score;
+}
+
+Score territory_score(int row_count, int col_count,
+                      const std::vector<Color> &stones,
+                      const std::vector<bool> &dead) {
+  Score score = count_regions(row_count, col_count, stones, dead);
+  for (int i = 0; i < (int)stones.size(); ++i) {
+    const bool is_stone = stones[i] != Color::kNone;
+    const bool is_dead = is_stone && !dead.empty() && dead[i];
+    if (is_stone && !is_dead) continue;
+    if (score.owner[i] == Color::kBlack) score.black++;
+    if (score.owner[i] == Color::kWhite) score.white++;
+    if (is_dead && stones[i] == Color::kBlack) score.white++;
+    if (is_dead && stones[i] == Color::kWhite) score.black++;
+  }
+  return score;
+}
+
+}  // namespace wq
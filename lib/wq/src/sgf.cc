@@ -0,0 +1,389 @@
+#include "sgf.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace wq {
+
+static bool is_space(char ch) { return (unsigned char)ch <= ' '; }
+
+static bool is_letter(char ch) {
+  return ('A' <= ch && ch <= 'Z') || ('a' <= ch && ch <= 'z');
+}
+
+static std::string_view trim(std::string_view v) {
+  while (!v.empty() && is_space(v.front())) v.remove_prefix(1);
+  while (!v.empty() && is_space(v.back())) v.remove_suffix(1);
+  return v;
+}
+
+static bool parse_int(std::string_view v, int &out) {
+  v = trim(v);
+  const auto [end, ec] = std::from_chars(v.data(), v.data() + v.size(), out);
+  return ec == std::errc() && end == v.data() + v.size();
+}
+
+static bool parse_double(std::string_view v, double &out) {
+  v = trim(v);
+  char buf[32];
+  if (v.empty() || v.size() >= sizeof(buf)) return false;
+  std::memcpy(buf, v.data(), v.size());
+  buf[v.size()] = '\0';
+  char *end;
+  out = std::strtod(buf, &end);
+  return end == buf + v.size();
+}
+
+// Empty values are passes. "tt" is left as the point (19, 19), since it is
+// only a pass on boards of at most 19x19.
+static bool parse_point(std::string_view v, Point &p) {
+  if (v.empty()) {
+    p = kPass;
+    return true;
+  }
+  if (v.size() != 2 || v[0] < 'a' || v[0] > 'z' || v[1] < 'a' || v[1] > 'z')
+    return false;
+  p = Point(v[1] - 'a', v[0] - 'a');
+  return true;
+}
+
+static void append_point(const Point &p, std::string &out) {
+  if (p == kPass) return;
+  out += (char)('a' + p.second);
+  out += (char)('a' + p.first);
+}
+
+SgfTokenizer::SgfTokenizer(std::string_view text) : text_(text) {}
+
+SgfToken SgfTokenizer::next() {
+  // Errors are final, so that callers can check them once at the end.
+  if (*error_) return SgfToken::kError;
+
+  while (pos_ < text_.size() && is_space(text_[pos_])) pos_++;
+  if (pos_ == text_.size()) return SgfToken::kEnd;
+
+  switch (text_[pos_]) {
+    case '(':
+      pos_++;
+      property_id_ = {};
+      return SgfToken::kTreeBegin;
+    case ')':
+      pos_++;
+      property_id_ = {};
+      return SgfToken::kTreeEnd;
+    case ';':
+      pos_++;
+      property_id_ = {};
+      return SgfToken::kNode;
+    case '[':
+      if (property_id_.empty()) {
+        error_ = "value without a property";
+        return SgfToken::kError;
+      }
+      break;
+    default: {
+      const size_t begin = pos_;
+      while (pos_ < text_.size() && is_letter(text_[pos_])) pos_++;
+      if (pos_ == begin) {
+        error_ = "unexpected character";
+        return SgfToken::kError;
+      }
+      property_id_ = text_.substr(begin, pos_ - begin);
+      while (pos_ < text_.size() && is_space(text_[pos_])) pos_++;
+      if (pos_ == text_.size() || text_[pos_] != '[') {
+        error_ = "property without a value";
+        return SgfToken::kError;
+      }
+    }
+  }
+
+  // The value ends at the first ']' preceded by an even number of
+  // backslashes, which escape each other.
+  const size_t begin = pos_ + 1;
+  size_t from = begin;
+  while (true) {
+    const void *hit =
+        std::memchr(text_.data() + from, ']', text_.size() - from);
+    if (!hit) {
+      error_ = "unterminated value";
+      return SgfToken::kError;
+    }
+    const size_t close = (const char *)hit - text_.data();
+    size_t k = close;
+    while (k > begin && text_[k - 1] == '\\') k--;
+    if ((close - k) % 2 == 0) {
+      value_ = text_.substr(begin, close - begin);
+      pos_ = close + 1;
+      return SgfToken::kValue;
+    }
+    from = close + 1;
+  }
+}
+
+std::string_view SgfTokenizer::property_id() const { return property_id_; }
+
+std::string_view SgfTokenizer::value() const { return value_; }
+
+size_t SgfTokenizer::offset() const { return pos_; }
+
+const char *SgfTokenizer::error() const { return error_; }
+
+void SgfGame::clear() {
+  row_count = 19;
+  col_count = 19;
+  komi = 0;
+  handicap = 0;
+  black_player.clear();
+  white_player.clear();
+  date.clear();
+  result.clear();
+  setup.clear();
+  moves.clear();
+}
+
+SgfReader::SgfReader(std::string_view text) : tokenizer_(text) {}
+
+bool SgfReader::next(SgfGame &game) {
+  while (true) {
+    switch (tokenizer_.next()) {
+      case SgfToken::kEnd:
+        return false;
+      case SgfToken::kTreeBegin:
+        if (read_tree(game)) return true;
+        break;
+      case SgfToken::kError:
+        return fail(tokenizer_.error());
+      default:
+        return fail("expected '('");
+    }
+  }
+}
+
+int64_t SgfReader::error_count() const { return error_count_; }
+
+const std::string &SgfReader::error() const { return error_; }
+
+bool SgfReader::read_tree(SgfGame &game) {
+  game.clear();
+
+  // The main line goes through the first subtree of every tree, and the
+  // properties of any other subtree are not even looked at.
+  int depth = 1;
+  int main_depth = 1;
+  bool on_main = true;
+  bool moved = false;
+  const char *problem = nullptr;
+  while (depth > 0) {
+    switch (tokenizer_.next()) {
+      case SgfToken::kEnd:
+        return fail("unterminated game tree");
+      case SgfToken::kError:
+        // Reported by next().
+        return false;
+      case SgfToken::kTreeBegin:
+        depth++;
+        if (on_main && depth == main_depth + 1) main_depth = depth;
+        break;
+      case SgfToken::kTreeEnd:
+        if (depth == main_depth) on_main = false;
+        depth--;
+        break;
+      case SgfToken::kNode:
+        break;
+      case SgfToken::kValue: {
+        if (!on_main || depth != main_depth || problem) break;
+        const std::string_view id = tokenizer_.property_id();
+        const std::string_view v = tokenizer_.value();
+        if (id == "B" || id == "W") {
+          Point p;
+          if (!parse_point(v, p)) {
+            problem = "invalid move";
+            break;
+          }
+          game.moves.emplace_back(id == "B" ? Color::kBlack : Color::kWhite,
+                                  p);
+          moved = true;
+        } else if (id == "AB" || id == "AW" || id == "AE") {
+          if (moved) {
+            problem = "stones set up after the first move";
+            break;
+          }
+          // Compressed lists give a rectangle as two corners.
+          const size_t colon = v.find(':');
+          Point from, to;
+          if (!parse_point(v.substr(0, colon), from) || from == kPass ||
+              !parse_point(colon == std::string_view::npos
+                               ? v
+                               : v.substr(colon + 1),
+                           to) ||
+              to == kPass) {
+            problem = "invalid point";
+            break;
+          }
+          for (int r = std::min(from.first, to.first);
+               r <= std::max(from.first, to.first); ++r) {
+            for (int c = std::min(from.second, to.second);
+                 c <= std::max(from.second, to.second); ++c) {
+              const Point p(r, c);
+              game.setup.erase(
+                  std::remove_if(game.setup.begin(), game.setup.end(),
+                                 [&](const Move &m) { return m.second == p; }),
+                  game.setup.end());
+              if (id != "AE") {
+                game.setup.emplace_back(
+                    id == "AB" ? Color::kBlack : Color::kWhite, p);
+              }
+            }
+          }
+        } else if (id == "SZ") {
+          // Columns first, as in SZ[19:13].
+          const size_t colon = v.find(':');
+          const bool ok =
+              colon == std::string_view::npos
+                  ? parse_int(v, game.col_count) &&
+                        parse_int(v, game.row_count)
+                  : parse_int(v.substr(0, colon), game.col_count) &&
+                        parse_int(v.substr(colon + 1), game.row_count);
+          if (!ok || game.row_count < 1 || game.row_count > kMaxBoardSize ||
+              game.col_count < 1 || game.col_count > kMaxBoardSize) {
+            problem = "unsupported board size";
+          }
+        } else if (id == "GM") {
+          int gm;
+          if (!parse_int(v, gm) || gm != 1) problem = "not a Go game";
+        } else if (id == "KM") {
+          if (!parse_double(v, game.komi)) problem = "invalid komi";
+        } else if (id == "HA") {
+          if (!parse_int(v, game.handicap)) problem = "invalid handicap";
+        } else if (id == "PB") {
+          game.black_player.clear();
+          sgf_unescape(v, game.black_player);
+        } else if (id == "PW") {
+          game.white_player.clear();
+          sgf_unescape(v, game.white_player);
+        } else if (id == "DT") {
+          game.date.clear();
+          sgf_unescape(v, game.date);
+        } else if (id == "RE") {
+          game.result.clear();
+          sgf_unescape(v, game.result);
+        }
+        break;
+      }
+    }
+  }
+  if (problem) return fail(problem);
+
+  // Points are only checked once the board size is known, since SZ may come
+  // after them in the root node.
+  const bool tt_is_pass = game.row_count <= 19 && game.col_count <= 19;
+  const auto inside = [&](const Point &p) {
+    return 0 <= p.first && p.first < game.row_count && 0 <= p.second &&
+           p.second < game.col_count;
+  };
+  for (const auto &[col, p] : game.setup) {
+    if (!inside(p)) return fail("setup stone outside the board");
+  }
+  for (auto &[col, p] : game.moves) {
+    if (tt_is_pass && p == Point(19, 19)) p = kPass;
+    if (p != kPass && !inside(p)) return fail("move outside the board");
+  }
+  return true;
+}
+
+bool SgfReader::fail(const char *message) {
+  error_ = "offset " + std::to_string(tokenizer_.offset()) + ": " + message;
+  error_count_++;
+  return false;
+}
+
+void sgf_unescape(std::string_view raw, std::string &out) {
+  if (raw.find('\\') == std::string_view::npos) {
+    out.append(raw);
+    return;
+  }
+  for (size_t i = 0; i < raw.size(); ++i) {
+    char ch = raw[i];
+    if (ch == '\\' && i + 1 < raw.size()) {
+      ch = raw[++i];
+      // Soft line break: "\r\n" and "\n\r" count as one.
+      if (ch == '\n' || ch == '\r') {
+        if (i + 1 < raw.size() && (raw[i + 1] == '\n' || raw[i + 1] == '\r') &&
+            raw[i + 1] != ch)
+          i++;
+        continue;
+      }
+    }
+    out += ch;
+  }
+}
+
+void sgf_escape(std::string_view text, std::string &out) {
+  for (const char ch : text) {
+    if (ch == ']' || ch == '\\') out += '\\';
+    out += ch;
+  }
+}
+
+static void write_text_property(const char *id, const std::string &text,
+                                std::string &out) {
+  if (text.empty()) return;
+  out += id;
+  out += '[';
+  sgf_escape(text, out);
+  out += ']';
+}
+
+static void write_setup(const char *id, Color col, const MoveList &setup,
+                        std::string &out) {
+  bool first = true;
+  for (const auto &[c, p] : setup) {
+    if (c != col) continue;
+    if (first) out += id;
+    first = false;
+    out += '[';
+    append_point(p, out);
+    out += ']';
+  }
+}
+
+void write_sgf(const SgfGame &game, std::string &out) {
+  // Passes are written as empty values, as in FF[4].
+  constexpr int kMovesPerLine = 10;
+
+  char buf[32];
+  out += "(;GM[1]FF[4]CA[UTF-8]SZ[";
+  out += std::to_string(game.col_count);
+  if (game.row_count != game.col_count) {
+    out += ':';
+    out += std::to_string(game.row_count);
+  }
+  out += ']';
+  std::snprintf(buf, sizeof(buf), "KM[%g]", game.komi);
+  out += buf;
+  if (game.handicap > 0) {
+    out += "HA[";
+    out += std::to_string(game.handicap);
+    out += ']';
+  }
+  write_text_property("PB", game.black_player, out);
+  write_text_property("PW", game.white_player, out);
+  write_text_property("DT", game.date, out);
+  write_text_property("RE", game.result, out);
+  write_setup("AB", Color::kBlack, game.setup, out);
+  write_setup("AW", Color::kWhite, game.setup, out);
+
+  for (size_t i = 0; i < game.moves.size(); ++i) {
+    const auto &[col, p] = game.moves[i];
+    if (i % kMovesPerLine == 0) out += '\n';
+    out += col == Color::kBlack ? ";B[" : ";W[";
+    append_point(p, out);
+    out += ']';
+  }
+  out += ")\n";
+}
+
+}  // namespace wq
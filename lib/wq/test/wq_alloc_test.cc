@@ -0,0 +1,67 @@
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+
+#include "wq.h"
+
+// Every allocation made by the process is counted, so that the test can
+// check that moves make none.
+static uint64_t alloc_count = 0;
+
+void *operator new(size_t size) {
+  alloc_count++;
+  if (void *p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+// Plays random legal moves on an empty size x size board and fails if any
+// of them that captures nothing allocates. Returns the number of such moves
+// checked.
+int check_plain_moves(int size, std::mt19937 &gen) {
+  wq::Board board(size, size);
+  wq::PointList removed;
+  wq::Color col = wq::Color::kBlack;
+  int checked = 0;
+  for (int i = 0; i < size * size; ++i) {
+    const int r = gen() % size;
+    const int c = gen() % size;
+    if (board.move_status(col, r, c) != wq::MoveStatus::kLegal) continue;
+    const uint64_t allocs = alloc_count;
+    board.move(col, r, c, removed);
+    if (removed.empty()) {
+      if (alloc_count != allocs) {
+        std::cerr << "move(" << r << ", " << c << ") on " << size << "x"
+                  << size << " made " << alloc_count - allocs
+                  << " allocations" << std::endl;
+        std::exit(1);
+      }
+      checked++;
+    }
+    col = col == wq::Color::kBlack ? wq::Color::kWhite : wq::Color::kBlack;
+  }
+  return checked;
+}
+
+}  // namespace
+
+int main() {
+  std::mt19937 gen(1);
+  int checked = 0;
+  for (int i = 0; i < 100; ++i) {
+    for (const int size : {9, 13, 19}) checked += check_plain_moves(size, gen);
+  }
+  if (checked == 0) {
+    std::cerr << "no moves checked" << std::endl;
+    return 1;
+  }
+  std::cout << checked << " moves without allocations" << std::endl;
+  return 0;
+}
@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "wq.h"
+
+namespace {
+
+constexpr int kSize = wq::BitBoard::kSize;
+
+// Counts of the move outcomes seen, so that the test can check it exercised
+// every rule.
+struct Outcomes {
+  int legal = 0;
+  int captures = 0;
+  int occupied = 0;
+  int suicides = 0;
+  int repetitions = 0;
+  int undos = 0;
+};
+
+void fail(const std::string &what) {
+  std::cerr << what << std::endl;
+  std::exit(1);
+}
+
+void check_same_stones(const wq::Board &board, const wq::BitBoard &bits) {
+  for (int r = 0; r < kSize; ++r) {
+    for (int c = 0; c < kSize; ++c) {
+      if (board.at(r, c) != bits.at(r, c)) {
+        fail("stones differ at (" + std::to_string(r) + ", " +
+             std::to_string(c) + ")");
+      }
+    }
+  }
+  if (board.last_move() != bits.last_move()) fail("last moves differ");
+}
+
+// Plays col at (r, c) on both boards and fails unless they agree on whether
+// the move is legal and on the stones it captures.
+bool check_move(wq::Board &board, wq::BitBoard &bits, wq::Color col, int r,
+                int c, Outcomes &out) {
+  const wq::MoveStatus status = board.move_status(col, r, c);
+  wq::PointList board_removed;
+  wq::PointList bits_removed;
+  const bool board_played = board.move(col, r, c, board_removed);
+  const bool bits_played = bits.move(col, r, c, bits_removed);
+  const std::string where =
+      "move(" + std::to_string(r) + ", " + std::to_string(c) + ")";
+  if (board_played != bits_played) fail(where + ": legality differs");
+  if (board_played != (status == wq::MoveStatus::kLegal)) {
+    fail(where + ": move_status differs from move");
+  }
+  switch (status) {
+    case wq::MoveStatus::kLegal:
+      out.legal++;
+      break;
+    case wq::MoveStatus::kOccupied:
+      out.occupied++;
+      break;
+    case wq::MoveStatus::kSuicide:
+      out.suicides++;
+      break;
+    case wq::MoveStatus::kRepetition:
+      out.repetitions++;
+      break;
+    case wq::MoveStatus::kOutside:
+      break;
+  }
+  if (!board_played) return false;
+  std::sort(board_removed.begin(), board_removed.end());
+  std::sort(bits_removed.begin(), bits_removed.end());
+  if (board_removed != bits_removed) fail(where + ": captures differ");
+  if (!board_removed.empty()) out.captures++;
+  return true;
+}
+
+void check_undo(wq::Board &board, wq::BitBoard &bits, Outcomes &out) {
+  int board_r = -1, board_c = -1;
+  int bits_r = -1, bits_c = -1;
+  wq::PointList board_added;
+  wq::PointList bits_added;
+  const bool board_undone = board.undo(board_r, board_c, board_added);
+  const bool bits_undone = bits.undo(bits_r, bits_c, bits_added);
+  if (board_undone != bits_undone) fail("undo: result differs");
+  if (!board_undone) return;
+  if (board_r != bits_r || board_c != bits_c) fail("undo: point differs");
+  std::sort(board_added.begin(), board_added.end());
+  std::sort(bits_added.begin(), bits_added.end());
+  if (board_added != bits_added) fail("undo: restored stones differ");
+  out.undos++;
+}
+
+// Plays a ko in the top-left corner: black may not retake it at once, but
+// may after both players have played elsewhere. Then white plays a suicide.
+void check_ko(Outcomes &out) {
+  wq::Board board(kSize, kSize, wq::KoRule::kPositionalSuperko);
+  wq::BitBoard bits;
+  const auto play = [&](wq::Color col, int r, int c, bool legal) {
+    if (check_move(board, bits, col, r, c, out) != legal) {
+      fail("ko: move(" + std::to_string(r) + ", " + std::to_string(c) +
+           ") should be " + (legal ? "legal" : "illegal"));
+    }
+  };
+  constexpr wq::Color B = wq::Color::kBlack;
+  constexpr wq::Color W = wq::Color::kWhite;
+  play(B, 0, 1, true);
+  play(W, 0, 2, true);
+  play(B, 1, 0, true);
+  play(W, 1, 3, true);
+  play(B, 2, 1, true);
+  play(W, 2, 2, true);
+  play(B, 1, 2, true);
+  // White takes the ko.
+  play(W, 1, 1, true);
+  // Black retaking at once repeats the position.
+  play(B, 1, 2, false);
+  play(B, 10, 10, true);
+  play(W, 10, 11, true);
+  // The stones played elsewhere make a new position, so black may retake.
+  play(B, 1, 2, true);
+  // A stone with no liberties that captures nothing is suicide.
+  play(W, 0, 0, false);
+  check_same_stones(board, bits);
+  while (board.last_move()) check_undo(board, bits, out);
+  check_same_stones(board, bits);
+}
+
+// Plays a triple ko in rows 1 to 3 until the sixth capture would bring back
+// the position the cycle started from. A simple ko rule allows that capture,
+// positional superko does not.
+void check_superko(Outcomes &out) {
+  wq::Board board(kSize, kSize, wq::KoRule::kPositionalSuperko);
+  wq::Board simple_board(kSize, kSize, wq::KoRule::kSimple);
+  wq::BitBoard bits;
+  wq::PointList removed;
+  const auto play = [&](wq::Color col, int r, int c, bool legal) {
+    if (check_move(board, bits, col, r, c, out) != legal) {
+      fail("superko: move(" + std::to_string(r) + ", " + std::to_string(c) +
+           ") should be " + (legal ? "legal" : "illegal"));
+    }
+    if (!simple_board.move(col, r, c, removed)) {
+      fail("superko: move(" + std::to_string(r) + ", " + std::to_string(c) +
+           ") should be legal under the simple ko rule");
+    }
+  };
+  constexpr wq::Color B = wq::Color::kBlack;
+  constexpr wq::Color W = wq::Color::kWhite;
+  // Black surrounds the left point of each ko and white the right one.
+  const int ko_cols[] = {2, 8, 14};
+  for (const int c : ko_cols) {
+    play(B, 1, c + 1, true);
+    play(B, 2, c, true);
+    play(B, 3, c + 1, true);
+    play(W, 1, c + 2, true);
+    play(W, 2, c + 3, true);
+    play(W, 3, c + 2, true);
+  }
+  const auto [x, y, z] = ko_cols;
+  // White holds the first and last kos, black the middle one.
+  play(W, 2, x + 1, true);
+  play(B, 2, y + 2, true);
+  play(W, 2, z + 1, true);
+  play(B, 2, x + 2, true);
+  play(W, 2, y + 1, true);
+  play(B, 2, z + 2, true);
+  play(W, 2, x + 1, true);
+  play(B, 2, y + 2, true);
+  if (check_move(board, bits, W, 2, z + 1, out)) {
+    fail("superko: the triple ko repeated a position");
+  }
+  if (!simple_board.move(W, 2, z + 1, removed)) {
+    fail("superko: the simple ko rule should allow the last capture");
+  }
+  check_same_stones(board, bits);
+  while (board.last_move()) check_undo(board, bits, out);
+  check_same_stones(board, bits);
+}
+
+// Plays random games on both boards, trying random empty points until one is
+// legal and now and then taking back a few moves, and compares every
+// outcome.
+void check_random_games(int game_count, std::mt19937 &gen, Outcomes &out) {
+  for (int g = 0; g < game_count; ++g) {
+    wq::Board board(kSize, kSize, wq::KoRule::kPositionalSuperko);
+    wq::BitBoard bits;
+    std::vector<wq::Point> empty;
+    wq::Color col = wq::Color::kBlack;
+    for (int i = 0; i < 3 * kSize * kSize; ++i) {
+      if (gen() % 16 == 0) {
+        for (int k = gen() % 5; k >= 0; --k) check_undo(board, bits, out);
+        check_same_stones(board, bits);
+      }
+      empty.clear();
+      for (int r = 0; r < kSize; ++r) {
+        for (int c = 0; c < kSize; ++c) {
+          if (board.at(r, c) == wq::Color::kNone) empty.emplace_back(r, c);
+        }
+      }
+      bool played = false;
+      while (!empty.empty() && !played) {
+        const size_t k = gen() % empty.size();
+        const auto [r, c] = empty[k];
+        played = check_move(board, bits, col, r, c, out);
+        empty[k] = empty.back();
+        empty.pop_back();
+      }
+      if (!played) break;
+      // Playing on a stone is rejected by both.
+      const auto [r, c] = board.last_move()->second;
+      check_move(board, bits, col, r, c, out);
+      check_same_stones(board, bits);
+      col = col == wq::Color::kBlack ? wq::Color::kWhite : wq::Color::kBlack;
+    }
+    while (board.last_move()) check_undo(board, bits, out);
+    check_same_stones(board, bits);
+  }
+}
+
+}  // namespace
+
+int main() {
+  Outcomes out;
+  check_ko(out);
+  check_superko(out);
+  std::mt19937 gen(1);
+  check_random_games(20, gen, out);
+  if (out.captures == 0 || out.occupied == 0 || out.suicides == 0 ||
+      out.repetitions == 0 || out.undos == 0) {
+    fail("some rules were not exercised");
+  }
+  std::cout << out.legal << " moves, " << out.captures << " captures, "
+            << out.suicides << " suicides, " << out.repetitions
+            << " repetitions and " << out.undos << " undos agree"
+            << std::endl;
+  return 0;
+}
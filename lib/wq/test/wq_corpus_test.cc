@@ -0,0 +1,196 @@
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+#include "corpus.h"
+
+// Writes games to a scratch corpus file, reads them back, and checks that
+// corrupt records are rejected instead of being decoded.
+
+namespace {
+
+constexpr wq::Color kBlack = wq::Color::kBlack;
+constexpr wq::Color kWhite = wq::Color::kWhite;
+
+int failures = 0;
+
+void check(bool ok, const std::string &what) {
+  if (ok) return;
+  std::cerr << "FAIL: " << what << std::endl;
+  failures++;
+}
+
+uint64_t get_u64(const std::string &data, size_t pos) {
+  uint64_t v = 0;
+  for (int i = 0; i < 8; ++i) v |= uint64_t(uint8_t(data[pos + i])) << (8 * i);
+  return v;
+}
+
+// Rewrites the file at path with patch applied to its bytes.
+void patch_file(const std::string &path,
+                const std::function<void(std::string &)> &patch) {
+  std::string data;
+  {
+    std::ifstream in(path, std::ios::binary);
+    data.assign(std::istreambuf_iterator<char>(in),
+                std::istreambuf_iterator<char>());
+  }
+  patch(data);
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(data.data(), data.size());
+}
+
+// Offset of the index, which follows the last record.
+uint64_t index_offset(const std::string &data) { return get_u64(data, 24); }
+
+// Offset of the record of the i-th game.
+uint64_t record_offset(const std::string &data, int64_t i) {
+  return get_u64(data, index_offset(data) + 8 * i);
+}
+
+bool write_corpus(const std::string &path,
+                  const std::vector<wq::SgfGame> &games) {
+  wq::CorpusWriter writer(path.c_str());
+  for (const auto &game : games) writer.add(game);
+  return writer.close();
+}
+
+void check_game(const wq::CorpusReader &reader, int64_t i,
+                const wq::SgfGame &want, wq::Color winner) {
+  const std::string name = "game " + std::to_string(i);
+  const auto game = reader.game(i);
+  check(game.has_value(), name + " is read");
+  if (!game) return;
+  check(game->row_count == want.row_count &&
+            game->col_count == want.col_count,
+        name + " size");
+  check(game->komi == want.komi, name + " komi");
+  check(game->winner == winner, name + " winner");
+
+  wq::MoveList moves;
+  check(game->setup.size() == int64_t(want.setup.size()) &&
+            game->setup.decode(moves) && moves == want.setup,
+        name + " setup");
+  check(game->moves.size() == int64_t(want.moves.size()) &&
+            game->moves.decode(moves) && moves == want.moves,
+        name + " moves");
+  moves.clear();
+  for (const wq::Move &m : game->moves) moves.push_back(m);
+  check(moves == want.moves, name + " iterated moves");
+}
+
+}  // namespace
+
+int main() {
+  const std::string path =
+      (std::filesystem::temp_directory_path() / "wq_corpus_test.corpus")
+          .string();
+
+  std::vector<wq::SgfGame> games(3);
+  games[0].komi = 6.5;
+  games[0].result = "W+R";
+  games[0].setup = {{kBlack, {3, 3}}, {kWhite, {15, 15}}};
+  // The last point has a two-byte code.
+  games[0].moves = {{kBlack, {2, 16}},
+                    {kWhite, {16, 2}},
+                    {kBlack, wq::kPass},
+                    {kWhite, {18, 18}}};
+  games[1].row_count = 9;
+  games[1].col_count = 13;
+  games[1].komi = -3.5;
+  games[1].result = "B+2.5";
+  games[1].moves = {{kBlack, {8, 12}}, {kWhite, {0, 0}}, {kBlack, {4, 6}}};
+  // Every code of a 3x3 board fits in a byte: 2 * 9 + 1 for a white pass.
+  games[2].row_count = 3;
+  games[2].col_count = 3;
+  games[2].setup = {{kBlack, {2, 2}}};
+  games[2].moves = {{kBlack, {0, 0}}, {kWhite, {1, 1}}};
+
+  // Round trip.
+  check(write_corpus(path, games), "write");
+  {
+    wq::CorpusReader reader;
+    check(reader.open(path.c_str()), "open: " + reader.error());
+    check(reader.size() == 3, "game count");
+    check_game(reader, 0, games[0], kWhite);
+    check_game(reader, 1, games[1], kBlack);
+    check_game(reader, 2, games[2], wq::Color::kNone);
+    check(!reader.game(3), "game past the end");
+  }
+
+  // A varint cut by the end of its stream.
+  patch_file(path, [](std::string &data) {
+    data[record_offset(data, 1) - 1] |= 0x80;
+  });
+  {
+    wq::CorpusReader reader;
+    check(reader.open(path.c_str()), "open truncated move: " + reader.error());
+    wq::MoveList moves;
+    const auto game = reader.game(0);
+    check(game && !game->moves.decode(moves), "truncated move is rejected");
+  }
+
+  // A record too short for its header.
+  check(write_corpus(path, games), "write");
+  patch_file(path, [](std::string &data) {
+    const uint64_t offset = index_offset(data) - 1;
+    for (int i = 0; i < 8; ++i) data[index_offset(data) + i] = offset >> (8 * i);
+  });
+  {
+    wq::CorpusReader reader;
+    check(reader.open(path.c_str()), "open truncated record");
+    check(!reader.game(0), "truncated record is rejected");
+  }
+
+  // The 3x3 record holds one setup stone then two moves, one byte each, at
+  // its very end.
+  check(write_corpus(path, games), "write");
+  patch_file(path, [](std::string &data) {
+    // Black at index 10, past the pass index 9.
+    data[index_offset(data) - 1] = 20;
+  });
+  {
+    wq::CorpusReader reader;
+    check(reader.open(path.c_str()), "open off-board move");
+    wq::MoveList moves;
+    const auto game = reader.game(2);
+    check(game && !game->moves.decode(moves), "off-board move is rejected");
+  }
+
+  check(write_corpus(path, games), "write");
+  patch_file(path, [](std::string &data) {
+    // A black pass among the setup stones.
+    data[index_offset(data) - 3] = 18;
+  });
+  {
+    wq::CorpusReader reader;
+    check(reader.open(path.c_str()), "open setup pass");
+    wq::MoveList moves;
+    const auto game = reader.game(2);
+    check(game && !game->setup.decode(moves), "setup pass is rejected");
+    check(game && game->moves.decode(moves), "moves after setup pass");
+  }
+
+  std::remove(path.c_str());
+
+  // A file that cannot be created.
+  {
+    const std::string bad_path =
+        (std::filesystem::temp_directory_path() / "wq_corpus_test_missing" /
+         "games.corpus")
+            .string();
+    wq::CorpusWriter writer(bad_path.c_str());
+    check(!writer.ok(), "writer to a missing directory fails");
+    writer.add(games[0]);
+    check(!writer.close(), "close reports the failed open");
+  }
+
+  if (failures > 0) return 1;
+  std::cout << "corpus round trip and corruption checks passed" << std::endl;
+  return 0;
+}
@@ -1,5 +1,7 @@
 #include "game_window.h"
 
+#include <algorithm>
+
 #include "color.h"
 #include "log.h"
 
@@ -9,7 +11,8 @@ GameWindow::GameWindow(AppContext& ctx, int board_size) : Window(ctx) {
   gtk_window_set_default_size(GTK_WINDOW(window_), 800, 800);
 
   // Board
-  board_ = std::make_unique<wq::Board>(board_size, board_size);
+  board_ = std::make_unique<wq::Board>(board_size, board_size, kKoRule);
+  update_keyframes();
   goban_ =
       std::make_unique<GtkBoard>("main_board", board_size, 0, 0, board_size - 1,
                                  board_size - 1, ctx_.rand());
@@ -87,11 +90,13 @@ void GameWindow::toggle_turn() {
 void GameWindow::set_board_size(int board_size) {
   assert(1 <= board_size && board_size <= 19);
   turn_ = wq::Color::kBlack;
-  board_ = std::make_unique<wq::Board>(board_size, board_size);
+  board_ = std::make_unique<wq::Board>(board_size, board_size, kKoRule);
   goban_->resize(board_size, 0, 0, board_size - 1, board_size - 1);
   cur_move_ = 0;
   moves_.clear();
   variation_moves_.clear();
+  keyframes_.clear();
+  update_keyframes();
 }
 
 bool GameWindow::move(int r, int c, MoveFlag flags) {
@@ -103,14 +108,15 @@ bool GameWindow::move(int r, int c, MoveFlag flags) {
   if (flags & kMoveFlagVariation) {
     variation_moves_.push_back(wq::Move(turn_, wq::Point(r, c)));
   } else {
-    if (cur_move_ < moves_.size()) moves_.resize(cur_move_);
+    truncate_mainline();
     cur_move_++;
     moves_.push_back(wq::Move(turn_, wq::Point(r, c)));
+    update_keyframes();
   }
 
   if (flags & kMoveFlagSound) play_move_sound(removed.size());
 
-  if (prev_move) {
+  if (prev_move && prev_move->second != wq::kPass) {
     const auto& [pcol, pnt] = prev_move.value();
     const auto& [pr, pc] = pnt;
     goban_->set_annotation(pr, pc, AnnotationType::kNone);
@@ -139,11 +145,13 @@ bool GameWindow::move(int r, int c, MoveFlag flags) {
 void GameWindow::pass() {
   auto prev_move = board_->last_move();
 
-  if (cur_move_ < moves_.size()) moves_.resize(cur_move_);
+  board_->pass(turn_);
+  truncate_mainline();
   cur_move_++;
   moves_.push_back(wq::Move(turn_, wq::kPass));
+  update_keyframes();
 
-  if (prev_move) {
+  if (prev_move && prev_move->second != wq::kPass) {
     const auto& [pcol, pnt] = prev_move.value();
     const auto& [pr, pc] = pnt;
     goban_->set_annotation(pr, pc, AnnotationType::kNone);
@@ -153,8 +161,63 @@ void GameWindow::pass() {
 }
 
 void GameWindow::goto_move(int move_number) {
-  while (cur_move_ < move_number && goto_next_move());
-  while (cur_move_ > move_number && goto_prev_move());
+  const size_t target =
+      std::min((size_t)std::max(move_number, 0), moves_.size());
+  if (target == cur_move_ && variation_moves_.empty()) return;
+
+  // Remember what the widget shows to only push the differences at the end.
+  const int rows = board_->row_count();
+  const int cols = board_->col_count();
+  std::vector<wq::Color> shown(rows * cols);
+  for (int r = 0; r < rows; ++r) {
+    for (int c = 0; c < cols; ++c) shown[r * cols + c] = board_->at(r, c);
+  }
+
+  // Clear the variation and last move annotations
+  for (const auto& [col, pnt] : variation_moves_) {
+    if (pnt == wq::kPass) continue;
+    goban_->set_text(pnt.first, pnt.second, "");
+    goban_->set_annotation(pnt.first, pnt.second, AnnotationType::kNone);
+  }
+  if (cur_move_ > 0 && moves_[cur_move_ - 1].second != wq::kPass) {
+    const auto& [r, c] = moves_[cur_move_ - 1].second;
+    goban_->set_annotation(r, c, AnnotationType::kNone);
+  }
+
+  // Start from the nearest keyframe, unless the current position is closer
+  const size_t plies = cur_move_ + variation_moves_.size();
+  const size_t keyframe =
+      std::min(target / kKeyframeInterval, keyframes_.size() - 1);
+  if (!variation_moves_.empty() || cur_move_ > target ||
+      cur_move_ < keyframe * kKeyframeInterval) {
+    board_->restore(keyframes_[keyframe]);
+    cur_move_ = keyframe * kKeyframeInterval;
+  }
+  variation_moves_.clear();
+
+  // Replay the remaining moves in the rules engine only
+  wq::PointList removed;
+  while (cur_move_ < target) {
+    const auto& [col, pnt] = moves_[cur_move_];
+    if (pnt == wq::kPass) {
+      board_->pass(col);
+    } else if (!board_->move(col, pnt.first, pnt.second, removed)) {
+      LOG(ERROR) << "goto_move: move " << cur_move_ << " did not match";
+      std::exit(1);
+    }
+    cur_move_++;
+    update_keyframes();
+  }
+  if ((plies + target) % 2) toggle_turn();
+
+  // Push the changed points to the widget
+  for (int r = 0; r < rows; ++r) {
+    for (int c = 0; c < cols; ++c) {
+      const wq::Color col = board_->at(r, c);
+      if (col != shown[r * cols + c]) goban_->set_point(r, c, col);
+    }
+  }
+  annotate_last_move();
 }
 
 bool GameWindow::goto_prev_move() {
@@ -170,19 +233,19 @@ bool GameWindow::goto_prev_move() {
     last = moves_[cur_move_].second;
   }
 
-  // If it was not pass, remove it from board state
+  // Remove it from board state, and from the widget if it was not pass
+  int r, c;
+  wq::PointList added;
+  if (!board_->undo(r, c, added)) {
+    LOG(ERROR) << "undo move did not match";
+    std::exit(1);
+  }
+  if (wq::Point(r, c) != last) {
+    LOG(ERROR) << "wtf: goto_prev_move: want (" << last.first << ","
+               << last.second << "), got (" << r << "," << c << ")";
+  }
+  assert(wq::Point(r, c) == last);
   if (last != wq::kPass) {
-    int r, c;
-    wq::PointList added;
-    if (!board_->undo(r, c, added)) {
-      LOG(ERROR) << "undo move did not match";
-      std::exit(1);
-    }
-    if (wq::Point(r, c) != last) {
-      LOG(ERROR) << "wtf: goto_prev_move: want (" << last.first << ","
-                 << last.second << "), got (" << r << "," << c << ")";
-    }
-    assert(wq::Point(r, c) == last);
     goban_->set_text(r, c, "");
     goban_->set_annotation(r, c, AnnotationType::kNone);
     goban_->set_point(r, c, wq::Color::kNone);
@@ -233,13 +296,14 @@ bool GameWindow::goto_next_move() {
   const auto& [col, pnt] = moves_[cur_move_];
   const auto& [r, c] = pnt;
   wq::PointList removed;
-  if (pnt != wq::kPass) {
-    if (!board_->move(turn_, r, c, removed)) {
-      LOG(ERROR) << "next move did not match";
-      std::exit(1);
-    }
+  if (pnt == wq::kPass) {
+    board_->pass(turn_);
+  } else if (!board_->move(turn_, r, c, removed)) {
+    LOG(ERROR) << "next move did not match";
+    std::exit(1);
   }
   cur_move_++;
+  update_keyframes();
 
   // Remove annotation from previous point
   if (last != wq::kPass) {
@@ -287,6 +351,29 @@ void GameWindow::on_point_leave(int r, int c) {
   goban_->set_annotation(r, c, AnnotationType::kNone);
 }
 
+void GameWindow::truncate_mainline() {
+  if (cur_move_ >= moves_.size()) return;
+  moves_.resize(cur_move_);
+  keyframes_.resize(
+      std::min(keyframes_.size(), cur_move_ / kKeyframeInterval + 1));
+}
+
+void GameWindow::update_keyframes() {
+  if (!variation_moves_.empty() || cur_move_ % kKeyframeInterval != 0) return;
+  if (keyframes_.size() != cur_move_ / kKeyframeInterval) return;
+  keyframes_.push_back(board_->snapshot());
+}
+
+void GameWindow::annotate_last_move() {
+  if (cur_move_ == 0) return;
+  const auto& [col, pnt] = moves_[cur_move_ - 1];
+  if (pnt == wq::kPass) return;
+  const auto& [r, c] = pnt;
+  goban_->set_annotation(r, c, AnnotationType::kBottomRightTriangle);
+  goban_->set_annotation_color(
+      r, c, col == wq::Color::kBlack ? color_white : color_black);
+}
+
 void GameWindow::play_move_sound(size_t capture_count) {
   GtkMediaStream* snd = ctx_.play_stone_sound();
   if (capture_count > 5)
@@ -302,9 +389,9 @@ void GameWindow::play_move_sound(size_t capture_count) {
 void GameWindow::on_first_move_clicked(GtkWidget* /*self*/,
                                        gpointer user_data) {
   GameWindow* win = (GameWindow*)user_data;
-  bool changed = false;
-  while (win->goto_prev_move()) changed = true;
-  if (changed) win->on_board_position_changed();
+  if (win->cur_move_ == 0 && win->variation_moves_.empty()) return;
+  win->goto_move(0);
+  win->on_board_position_changed();
 }
 
 void GameWindow::on_prev_n_moves_clicked(GtkWidget* /*self*/,
@@ -341,9 +428,10 @@ void GameWindow::on_next_n_moves_clicked(GtkWidget* /*self*/,
 
 void GameWindow::on_last_move_clicked(GtkWidget* /*self*/, gpointer user_data) {
   GameWindow* win = (GameWindow*)user_data;
-  bool changed = false;
-  while (win->goto_next_move()) changed = true;
-  if (changed) win->on_board_position_changed();
+  if (!win->variation_moves_.empty() || win->cur_move_ >= win->moves_.size())
+    return;
+  win->goto_move(win->moves_.size());
+  win->on_board_position_changed();
 }
 
 }  // namespace ui
\ No newline at end of file
@@ -9,6 +9,7 @@
 #include "color.h"
 #include "log.h"
 #include "play_ai_preset_window.h"
+#include "score.h"
 
 namespace ui {
 
@@ -196,6 +197,12 @@ void PlayAIWindow::gen_move() {
           return;
         }
 
+        // Only sample legal moves; the last entry of the policy is the pass.
+        const std::vector<bool> legal = board().legal_moves(turn());
+        for (size_t i = 0;
+             i < legal.size() && i < resp.human_policy.size(); ++i) {
+          if (!legal[i]) resp.human_policy[i] = 0;
+        }
         for (double& p : resp.human_policy) p = std::clamp(p, 0., 1.);
         std::discrete_distribution<> dist(resp.human_policy.begin(),
                                           resp.human_policy.end());
@@ -204,8 +211,8 @@ void PlayAIWindow::gen_move() {
           pass();
           consecutive_pass_++;
         } else {
-          const int r = move_index / 19;
-          const int c = move_index % 19;
+          const int r = move_index / board().col_count();
+          const int c = move_index % board().col_count();
           move(r, c, kMoveFlagNone);
         }
         if (consecutive_pass_ == 2) finish_game(wq::Color::kNone, 0);
@@ -274,45 +281,36 @@ void PlayAIWindow::finish_game(wq::Color winner, double score_lead) {
             return;
           }
 
+          // The engine only decides which stones are dead; the position is
+          // then counted locally with area scoring.
+          const int rows = board().row_count();
+          const int cols = board().col_count();
+          const std::vector<wq::Color> stones = wq::board_stones(board());
+          if (resp.ownership.size() != stones.size()) {
+            LOG(ERROR) << "katago: counting: unexpected ownership size "
+                       << resp.ownership.size();
+            return;
+          }
+          std::vector<bool> dead(stones.size(), false);
+          for (int i = 0; i < (int)stones.size(); ++i) {
+            const double t = resp.ownership[i];
+            dead[i] = (stones[i] == wq::Color::kBlack && t < -0.9) ||
+                      (stones[i] == wq::Color::kWhite && t > 0.9);
+          }
+          const wq::Score score = wq::area_score(rows, cols, stones, dead);
           const double score_lead =
-              std::round(resp.root_info.score_lead + 0.5) - 0.5;
+              score.black - score.white - katago_query_.komi;
           const wq::Color winner =
               (score_lead > 0) ? wq::Color::kBlack : wq::Color::kWhite;
-          for (int i = 0; i < 19; ++i) {
-            for (int j = 0; j < 19; ++j) {
-              const double t = resp.ownership[i * 19 + j];
-              if (t > 0.9) {
-                switch (board().at(i, j)) {
-                  case wq::Color::kNone:
-                    board_widget().set_annotation(i, j,
-                                                  AnnotationType::kTerritory);
-                    board_widget().set_annotation_color(i, j, color_black);
-                    break;
-                  case wq::Color::kBlack:
-                    board_widget().set_annotation(i, j, AnnotationType::kNone);
-                    break;
-                  case wq::Color::kWhite:
-                    board_widget().set_annotation(i, j,
-                                                  AnnotationType::kTerritory);
-                    board_widget().set_annotation_color(i, j, color_black);
-                    break;
-                }
-              } else if (t < -0.9) {
-                switch (board().at(i, j)) {
-                  case wq::Color::kNone:
-                    board_widget().set_annotation(i, j,
-                                                  AnnotationType::kTerritory);
-                    board_widget().set_annotation_color(i, j, color_white);
-                    break;
-                  case wq::Color::kBlack:
-                    board_widget().set_annotation(i, j,
-                                                  AnnotationType::kTerritory);
-                    board_widget().set_annotation_color(i, j, color_white);
-                    break;
-                  case wq::Color::kWhite:
-                    board_widget().set_annotation(i, j, AnnotationType::kNone);
-                    break;
-                }
+          for (int i = 0; i < rows; ++i) {
+            for (int j = 0; j < cols; ++j) {
+              const wq::Color owner = score.owner_at(i, j);
+              if (owner != wq::Color::kNone && board().at(i, j) != owner) {
+                board_widget().set_annotation(i, j,
+                                              AnnotationType::kTerritory);
+                board_widget().set_annotation_color(
+                    i, j,
+                    owner == wq::Color::kBlack ? color_black : color_white);
               } else {
                 board_widget().set_annotation(i, j, AnnotationType::kNone);
               }
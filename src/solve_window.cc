@@ -317,15 +317,21 @@ void SolveWindow::reset_task(bool is_solved) {
   goban_->resize(task_.board_size_, task_.top_left_.first,
                  task_.top_left_.second, task_.bottom_right_.first,
                  task_.bottom_right_.second);
-  board_ = std::make_unique<wq::Board>(task_.board_size_, task_.board_size_);
-  for (const auto& [r, c] : task_.initial_[0]) {
-    board_->move(wq::Color::kBlack, r, c, removed);
-    goban_->set_point(r, c, wq::Color::kBlack);
+  if (is_solved) {
+    board_->restore(initial_position_);
+  } else {
+    board_ =
+        std::make_unique<wq::Board>(task_.board_size_, task_.board_size_);
+    for (const auto& [r, c] : task_.initial_[0])
+      board_->move(wq::Color::kBlack, r, c, removed);
+    for (const auto& [r, c] : task_.initial_[1])
+      board_->move(wq::Color::kWhite, r, c, removed);
+    board_->snapshot(initial_position_);
   }
-  for (const auto& [r, c] : task_.initial_[1]) {
-    board_->move(wq::Color::kWhite, r, c, removed);
+  for (const auto& [r, c] : task_.initial_[0])
+    goban_->set_point(r, c, wq::Color::kBlack);
+  for (const auto& [r, c] : task_.initial_[1])
     goban_->set_point(r, c, wq::Color::kWhite);
-  }
   for (const auto& [p, label] : task_.labels_) {
     const auto& [r, c] = p;
     if (label == "$triangle") {
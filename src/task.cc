@@ -24,7 +24,7 @@ constexpr const char *kTaskDBSchema = R"(
     initial_stones TEXT NOT NULL,
     answer_points  TEXT,
     labels         TEXT,
-    vtree          TEXT NOT NULL,
+    vtree          BLOB NOT NULL,
     metadata       TEXT
   );
 
@@ -72,164 +72,308 @@ constexpr const char *kTaskDBSchema = R"(
   );
 )";
 
-TaskDB::TaskDB(const char *path) {
-  if (sqlite3_open(path, &db_)) {
+// Indexes matching the filters of get_tasks(). Each tasks index holds every
+// column a preset filters on, so that preset queries never read task rows.
+constexpr const char *kTaskDBIndexes = R"(
+  CREATE INDEX IF NOT EXISTS tasks_by_source
+    ON tasks(source, type, rank, rating, board_size);
+  CREATE INDEX IF NOT EXISTS tasks_by_type
+    ON tasks(type, rank, rating, board_size);
+  CREATE INDEX IF NOT EXISTS tasks_by_rank ON tasks(rank, rating, board_size);
+  CREATE INDEX IF NOT EXISTS tasks_tags_by_task ON tasks_tags(task_id, tag_id);
+  CREATE INDEX IF NOT EXISTS tags_by_name ON tags(name);
+)";
+
+// Columns read by read_task(), in order.
+constexpr const char *kTaskColumns =
+    "tasks.id, tasks.source, tasks.description, tasks.type, tasks.rank, "
+    "tasks.rating, tasks.first_to_play, tasks.board_size, tasks.top_left_r, "
+    "tasks.top_left_c, tasks.bottom_right_r, tasks.bottom_right_c, "
+    "tasks.initial_stones, tasks.answer_points, tasks.labels, tasks.vtree, "
+    "tasks.metadata";
+
+namespace {
+
+// Resets a cached statement and clears its bindings when the call using it
+// returns, so that the next call finds it ready.
+class StatementReset {
+ public:
+  explicit StatementReset(sqlite3_stmt *stmt) : stmt_(stmt) {}
+  ~StatementReset() {
+    sqlite3_reset(stmt_);
+    sqlite3_clear_bindings(stmt_);
+  }
+
+ private:
+  sqlite3_stmt *stmt_;
+};
+
+}  // namespace
+
+// Values are only read while the statement runs, so they are not copied.
+static void bind_text(sqlite3_stmt *stmt, int index, std::string_view s) {
+  sqlite3_bind_text(stmt, index, s.data(), s.size(), SQLITE_STATIC);
+}
+
+static std::string column_text(sqlite3_stmt *stmt, int index) {
+  const unsigned char *text = sqlite3_column_text(stmt, index);
+  if (!text) return {};
+  return std::string((const char *)text, sqlite3_column_bytes(stmt, index));
+}
+
+TaskDB::TaskDB(const char *path, bool read_only) {
+  const int flags = read_only ? SQLITE_OPEN_READONLY
+                              : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+  if (sqlite3_open_v2(path, &db_, flags, nullptr)) {
     LOG(ERROR) << "task db: failed to open task database: "
                << sqlite3_errmsg(db_);
     sqlite3_close(db_);
     std::exit(1);
   }
+  if (read_only) return;
   if (sqlite3_exec(db_, kTaskDBSchema, nullptr, nullptr, nullptr)) {
     LOG(INFO) << "task db: applying schema: code=" << sqlite3_errcode(db_)
               << " msg='" << sqlite3_errmsg(db_) << "'";
     std::exit(1);
   }
+  migrate();
 }
 
-TaskDB::~TaskDB() { sqlite3_close(db_); }
+TaskDB::~TaskDB() {
+  for (const auto &[sql, stmt] : statements_) sqlite3_finalize(stmt);
+  sqlite3_close(db_);
+}
 
-int64_t TaskDB::get_tag_id(std::string_view tag_name) const {
-  int64_t id = -1;
-  std::ostringstream q;
-  q << "SELECT id FROM tags WHERE name = '" << tag_name << "';";
-  if (sqlite3_exec(db_, q.str().c_str(), get_tag_id_cb, &id, nullptr)) {
-    LOG(ERROR) << "get_tag_id: code=" << sqlite3_errcode(db_) << ": "
-               << sqlite3_errmsg(db_);
-    return -1;
+sqlite3_stmt *TaskDB::prepare(const std::string &sql) const {
+  auto it = statements_.find(sql);
+  if (it != statements_.end()) return it->second;
+
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v3(db_, sql.c_str(), sql.size() + 1,
+                         SQLITE_PREPARE_PERSISTENT, &stmt, nullptr)) {
+    LOG(ERROR) << "task db: preparing statement: code=" << sqlite3_errcode(db_)
+               << ": " << sqlite3_errmsg(db_) << "\nquery: `" << sql << "`";
+    return nullptr;
   }
-  return id;
+  statements_.emplace(sql, stmt);
+  return stmt;
 }
 
-int TaskDB::get_tag_id_cb(void *out, int /*column_count*/, char **column_value,
-                          char ** /*column_name*/) {
-  int64_t &id = *(int64_t *)out;
-  id = std::stoll(column_value[0]);
-  return 0;
+bool TaskDB::step_done(sqlite3_stmt *stmt, const char *caller) const {
+  if (sqlite3_step(stmt) == SQLITE_DONE) return true;
+  LOG(ERROR) << caller << ": code=" << sqlite3_errcode(db_) << ": "
+             << sqlite3_errmsg(db_) << "\nquery: `" << sqlite3_sql(stmt)
+             << "`";
+  return false;
 }
 
-int64_t TaskDB::add_tag(std::string_view tag_name) {
-  int64_t id = get_tag_id(tag_name);
-  if (id != -1) return id;
+void TaskDB::migrate() {
+  int version = 0;
+  if (sqlite3_stmt *stmt = prepare("PRAGMA user_version;")) {
+    StatementReset reset(stmt);
+    if (sqlite3_step(stmt) == SQLITE_ROW) version = sqlite3_column_int(stmt, 0);
+  }
 
-  std::ostringstream q;
-  q << "INSERT INTO tags (name) VALUES ('" << tag_name << "');";
-  if (sqlite3_exec(db_, q.str().c_str(), nullptr, nullptr, nullptr)) {
-    LOG(ERROR) << "add_tag: code=" << sqlite3_errcode(db_) << ": "
-               << sqlite3_errmsg(db_);
-    return -1;
+  // Version 1: vtrees are BLOBs instead of JSON text. Rows are read before
+  // any is updated, since SQLite does not define what a running query sees of
+  // changes made under it.
+  if (version < 1) {
+    sqlite3_exec(db_, "BEGIN;", nullptr, nullptr, nullptr);
+    sqlite3_stmt *select = prepare(
+        "SELECT id, board_size, top_left_r, top_left_c, bottom_right_r, "
+        "bottom_right_c, vtree FROM tasks WHERE typeof(vtree) = 'text';");
+    sqlite3_stmt *update = prepare("UPDATE tasks SET vtree = ? WHERE id = ?;");
+    if (!select || !update) std::exit(1);
+
+    std::vector<std::pair<Task, std::string>> rows;
+    {
+      StatementReset reset(select);
+      while (sqlite3_step(select) == SQLITE_ROW) {
+        Task task;
+        task.id_ = sqlite3_column_int64(select, 0);
+        task.board_size_ = sqlite3_column_int(select, 1);
+        task.top_left_ = wq::Point(sqlite3_column_int(select, 2),
+                                   sqlite3_column_int(select, 3));
+        task.bottom_right_ = wq::Point(sqlite3_column_int(select, 4),
+                                       sqlite3_column_int(select, 5));
+        rows.emplace_back(std::move(task), column_text(select, 6));
+      }
+    }
+
+    StatementReset reset(update);
+    int64_t converted = 0;
+    for (auto &[task, text] : rows) {
+      try {
+        task.vtree_ = TaskVTree(*decode_task_vtree(json::parse(text)));
+      } catch (const json::exception &) {
+        // Left as is, to be reported when loaded.
+        continue;
+      }
+      const auto blob = encode_task_vtree_blob(task);
+      if (!blob) continue;
+      sqlite3_bind_blob(update, 1, blob->data(), blob->size(), SQLITE_STATIC);
+      sqlite3_bind_int64(update, 2, task.id_);
+      if (!step_done(update, "migrate")) std::exit(1);
+      sqlite3_reset(update);
+      converted++;
+    }
+    sqlite3_exec(db_, "PRAGMA user_version = 1; COMMIT;", nullptr, nullptr,
+                 nullptr);
+    if (converted > 0) {
+      LOG(INFO) << "task db: converted " << converted << " vtrees to blobs";
+    }
   }
-  return sqlite3_last_insert_rowid(db_);
-}
 
-void TaskDB::add_tag(int64_t tag_id, std::string_view tag_name) {
-  std::ostringstream q;
-  q << "INSERT INTO tags (id, name) VALUES (" << tag_id << ", '" << tag_name
-    << "');";
-  if (sqlite3_exec(db_, q.str().c_str(), nullptr, nullptr, nullptr)) {
-    LOG(ERROR) << "add_tag: code=" << sqlite3_errcode(db_) << ": "
+  // Secondary indexes are created on every open rather than in a versioned
+  // step, so that any left dropped by an interrupted BulkWriter import are
+  // rebuilt.
+  if (sqlite3_exec(db_, kTaskDBIndexes, nullptr, nullptr, nullptr)) {
+    LOG(ERROR) << "migrate: code=" << sqlite3_errcode(db_) << ": "
                << sqlite3_errmsg(db_);
+    std::exit(1);
   }
 }
 
-std::optional<TaskTag> TaskDB::get_tag(int64_t tag_id) const {
-  std::optional<TaskTag> tag;
-  std::ostringstream q;
-  q << "SELECT id, name, description, url FROM tags WHERE id = " << tag_id
-    << ";";
-  if (sqlite3_exec(db_, q.str().c_str(), get_tag_cb, &tag, nullptr)) {
-    LOG(ERROR) << "get_tag(" << tag_id << "): code=" << sqlite3_errcode(db_)
-               << ": " << sqlite3_errmsg(db_) << "\nquery: " << q.str();
-    return {};
+int64_t TaskDB::get_tag_id(std::string_view tag_name) const {
+  sqlite3_stmt *stmt = prepare("SELECT id FROM tags WHERE name = ?;");
+  if (!stmt) return -1;
+  StatementReset reset(stmt);
+  bind_text(stmt, 1, tag_name);
+
+  switch (sqlite3_step(stmt)) {
+    case SQLITE_ROW:
+      return sqlite3_column_int64(stmt, 0);
+    case SQLITE_DONE:
+      return -1;
   }
-  return tag;
+  LOG(ERROR) << "get_tag_id: code=" << sqlite3_errcode(db_) << ": "
+             << sqlite3_errmsg(db_);
+  return -1;
 }
 
-int TaskDB::get_tag_cb(void *out, int /*column_count*/, char **column_value,
-                       char ** /*column_name*/) {
-  TaskTag tag;
+int64_t TaskDB::add_tag(std::string_view tag_name) {
+  int64_t id = get_tag_id(tag_name);
+  if (id != -1) return id;
 
-  tag.id_ = std::stoll(column_value[0]);
-  tag.name_ = column_value[1];
-  if (column_value[2]) tag.description_ = column_value[2];
-  if (column_value[3]) tag.url_ = column_value[3];
+  sqlite3_stmt *stmt = prepare("INSERT INTO tags (name) VALUES (?);");
+  if (!stmt) return -1;
+  StatementReset reset(stmt);
+  bind_text(stmt, 1, tag_name);
+  if (!step_done(stmt, "add_tag")) return -1;
+  return sqlite3_last_insert_rowid(db_);
+}
 
-  *((std::optional<TaskTag> *)out) = std::move(tag);
+void TaskDB::add_tag(int64_t tag_id, std::string_view tag_name) {
+  sqlite3_stmt *stmt = prepare("INSERT INTO tags (id, name) VALUES (?, ?);");
+  if (!stmt) return;
+  StatementReset reset(stmt);
+  sqlite3_bind_int64(stmt, 1, tag_id);
+  bind_text(stmt, 2, tag_name);
+  step_done(stmt, "add_tag");
+}
 
-  return 0;
+std::optional<TaskTag> TaskDB::get_tag(int64_t tag_id) const {
+  sqlite3_stmt *stmt =
+      prepare("SELECT id, name, description, url FROM tags WHERE id = ?;");
+  if (!stmt) return {};
+  StatementReset reset(stmt);
+  sqlite3_bind_int64(stmt, 1, tag_id);
+
+  switch (sqlite3_step(stmt)) {
+    case SQLITE_ROW: {
+      TaskTag tag;
+      tag.id_ = sqlite3_column_int64(stmt, 0);
+      tag.name_ = column_text(stmt, 1);
+      tag.description_ = column_text(stmt, 2);
+      tag.url_ = column_text(stmt, 3);
+      return tag;
+    }
+    case SQLITE_DONE:
+      return {};
+  }
+  LOG(ERROR) << "get_tag(" << tag_id << "): code=" << sqlite3_errcode(db_)
+             << ": " << sqlite3_errmsg(db_);
+  return {};
 }
 
 int64_t TaskDB::add_task(const Task &task) {
-  std::ostringstream q;
-  q << "INSERT INTO tasks (source, description, type, rank, rating, "
-       "first_to_play, "
-       "board_size, top_left_r, top_left_c, bottom_right_r, bottom_right_c, "
-       "initial_stones, answer_points, labels, vtree, metadata) VALUES ("
-    << "'" << task.source_ << "', "
-    << "'" << task.description_ << "', " << (int)task.type_ << ", "
-    << (int)task.rank_ << ", " << task.rating_ << ", "
-    << (int)task.first_to_play_ << ", " << task.board_size_ << ", "
-    << task.top_left_.first << ", " << task.top_left_.second << ", "
-    << task.bottom_right_.first << ", " << task.bottom_right_.second << ", "
-    << "'" << encode_task_initial_stones(task).dump() << "', "
-    << "'" << encode_task_answer_points(task).dump() << "', "
-    << "'" << encode_task_labels(task).dump() << "', "
-    << "'" << encode_task_vtree(task).dump() << "', "
-    << "'" << encode_metadata(task) << "');";
-
-  if (sqlite3_exec(db_, q.str().c_str(), nullptr, nullptr, nullptr)) {
-    LOG(ERROR) << "add_task: code=" << sqlite3_errcode(db_) << ": "
-               << sqlite3_errmsg(db_) << "\nquery: `" << q.str() << "`";
-    return -1;
+  sqlite3_stmt *stmt = prepare(
+      "INSERT INTO tasks (source, description, type, rank, rating, "
+      "first_to_play, board_size, top_left_r, top_left_c, bottom_right_r, "
+      "bottom_right_c, initial_stones, answer_points, labels, vtree, "
+      "metadata) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);");
+  if (!stmt) return -1;
+  StatementReset reset(stmt);
+
+  const std::string initial_stones = encode_task_initial_stones(task).dump();
+  const std::string answer_points = encode_task_answer_points(task).dump();
+  const std::string labels = encode_task_labels(task).dump();
+  const std::optional<std::string> vtree_blob = encode_task_vtree_blob(task);
+  const std::string vtree =
+      vtree_blob ? std::string() : encode_task_vtree(task).dump();
+  const std::string metadata = encode_metadata(task).dump();
+  bind_text(stmt, 1, task.source_);
+  bind_text(stmt, 2, task.description_);
+  sqlite3_bind_int(stmt, 3, (int)task.type_);
+  sqlite3_bind_int(stmt, 4, (int)task.rank_);
+  sqlite3_bind_double(stmt, 5, task.rating_);
+  sqlite3_bind_int(stmt, 6, (int)task.first_to_play_);
+  sqlite3_bind_int(stmt, 7, task.board_size_);
+  sqlite3_bind_int(stmt, 8, task.top_left_.first);
+  sqlite3_bind_int(stmt, 9, task.top_left_.second);
+  sqlite3_bind_int(stmt, 10, task.bottom_right_.first);
+  sqlite3_bind_int(stmt, 11, task.bottom_right_.second);
+  bind_text(stmt, 12, initial_stones);
+  bind_text(stmt, 13, answer_points);
+  bind_text(stmt, 14, labels);
+  if (vtree_blob) {
+    sqlite3_bind_blob(stmt, 15, vtree_blob->data(), vtree_blob->size(),
+                      SQLITE_STATIC);
+  } else {
+    bind_text(stmt, 15, vtree);
   }
+  bind_text(stmt, 16, metadata);
+  if (!step_done(stmt, "add_task")) return -1;
 
   const int64_t task_id = sqlite3_last_insert_rowid(db_);
 
   if (!task.tags_.empty()) {
-    q.str("");
-    q << "INSERT INTO tasks_tags (tag_id, task_id) VALUES ";
-    bool first = true;
+    sqlite3_stmt *tag_stmt =
+        prepare("INSERT INTO tasks_tags (tag_id, task_id) VALUES (?, ?);");
+    if (!tag_stmt) return -1;
+    StatementReset tag_reset(tag_stmt);
     for (const auto &tag_id : task.tags_) {
-      if (!first) {
-        q << ", ";
-      } else {
-        first = false;
-      }
-      q << "(" << tag_id << ", " << task_id << ")";
-    }
-    q << ";";
-
-    if (sqlite3_exec(db_, q.str().c_str(), nullptr, nullptr, nullptr)) {
-      LOG(ERROR) << "add_task (tag assoc): code=" << sqlite3_errcode(db_)
-                 << ": " << sqlite3_errmsg(db_) << "\nquery: `" << q.str()
-                 << "`";
-      return -1;
+      sqlite3_bind_int64(tag_stmt, 1, tag_id);
+      sqlite3_bind_int64(tag_stmt, 2, task_id);
+      if (!step_done(tag_stmt, "add_task (tag assoc)")) return -1;
+      sqlite3_reset(tag_stmt);
     }
   }
 
   return task_id;
 }
 
-std::vector<int64_t> TaskDB::get_tasks(SolvePreset preset) const {
+std::string TaskDB::tasks_query(const SolvePreset &preset) {
+  // The query text only depends on which filters are set and on the length
+  // of the lists, so presets share statements.
   std::ostringstream q;
-  q << "SELECT id FROM tasks ";
+  q << "SELECT id FROM tasks WHERE TRUE ";
 
+  // A correlated EXISTS rather than a join, so that tasks are found through
+  // an index on their own columns and tags are probed through
+  // tasks_tags_by_task, without reading task rows.
   if (!preset.tags_.empty()) {
-    q << "INNER JOIN tasks_tags ON tasks.id = tasks_tags.task_id AND "
-         "tasks_tags.tag_id IN (";
-    for (size_t i = 0; i < preset.tags_.size(); ++i) {
-      if (i > 0) q << ", ";
-      q << get_tag_id(preset.tags_[i]);
-    }
-    q << ")";
+    q << " AND EXISTS (SELECT 1 FROM tasks_tags WHERE "
+         "tasks_tags.task_id = tasks.id AND tasks_tags.tag_id IN "
+         "(SELECT id FROM tags WHERE name IN (";
+    for (size_t i = 0; i < preset.tags_.size(); ++i) q << (i > 0 ? ", ?" : "?");
+    q << ")))";
   }
 
-  q << "WHERE TRUE ";
-
   if (!preset.sources_.empty()) {
     q << " AND (source IN (";
     for (size_t i = 0; i < preset.sources_.size(); ++i) {
-      if (i > 0) q << ", ";
-      q << "'" << preset.sources_[i] << "'";
+      q << (i > 0 ? ", ?" : "?");
     }
     q << "))";
   }
@@ -237,64 +381,99 @@ std::vector<int64_t> TaskDB::get_tasks(SolvePreset preset) const {
   if (!preset.types_.empty()) {
     q << " AND (type IN (";
     for (size_t i = 0; i < preset.types_.size(); ++i) {
-      if (i > 0) q << ", ";
-      q << (int)preset.types_[i];
+      q << (i > 0 ? ", ?" : "?");
     }
     q << "))";
   }
 
+  if (preset.min_rank_ != Rank::kUnknown) q << " AND (? <= rank)";
+  if (preset.max_rank_ != Rank::kUnknown) q << " AND (rank <= ?)";
+  if (preset.min_rating_ > 0) q << " AND (? <= rating)";
+  if (preset.min_board_size_ > 0) q << " AND (? <= board_size)";
+  if (preset.max_board_size_ > 0) q << " AND (board_size <= ?)";
+
+  q << ";";
+  return q.str();
+}
+
+std::vector<int64_t> TaskDB::get_tasks(SolvePreset preset) const {
+  const std::string q = tasks_query(preset);
+  sqlite3_stmt *stmt = prepare(q);
+  if (!stmt) return {};
+  StatementReset reset(stmt);
+
+  // Parameters are bound in the order they appear in the query.
+  int index = 1;
+  for (const auto &tag : preset.tags_) bind_text(stmt, index++, tag);
+  for (const auto &source : preset.sources_) bind_text(stmt, index++, source);
+  for (const auto &type : preset.types_) {
+    sqlite3_bind_int(stmt, index++, (int)type);
+  }
   if (preset.min_rank_ != Rank::kUnknown) {
-    q << " AND (" << (int)preset.min_rank_ << " <= rank)";
+    sqlite3_bind_int(stmt, index++, (int)preset.min_rank_);
   }
-
   if (preset.max_rank_ != Rank::kUnknown) {
-    q << " AND (rank <= " << (int)preset.max_rank_ << ")";
+    sqlite3_bind_int(stmt, index++, (int)preset.max_rank_);
   }
-
   if (preset.min_rating_ > 0) {
-    q << " AND (" << preset.min_rating_ << " <= rating)";
+    sqlite3_bind_double(stmt, index++, preset.min_rating_);
   }
-
   if (preset.min_board_size_ > 0) {
-    q << " AND (" << preset.min_board_size_ << " <= board_size)";
+    sqlite3_bind_int(stmt, index++, preset.min_board_size_);
   }
-
   if (preset.max_board_size_ > 0) {
-    q << " AND (board_size <= " << preset.max_board_size_ << ")";
+    sqlite3_bind_int(stmt, index++, preset.max_board_size_);
   }
 
-  q << ";";
-
   std::vector<int64_t> ids;
-
-  if (sqlite3_exec(db_, q.str().c_str(), get_tasks_cb, &ids, nullptr)) {
+  int rc;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    const int64_t id = sqlite3_column_int64(stmt, 0);
+    if (id > 0) ids.push_back(id);
+  }
+  if (rc != SQLITE_DONE) {
     LOG(ERROR) << "get_tasks: code=" << sqlite3_errcode(db_) << ": "
-               << sqlite3_errmsg(db_) << "\nquery: " << q.str();
+               << sqlite3_errmsg(db_) << "\nquery: " << q;
     return {};
   }
 
   return ids;
 }
 
-int TaskDB::get_tasks_cb(void *out, int /*column_count*/, char **column_value,
-                         char ** /*column_name*/) {
-  int64_t id = std::stoll(column_value[0]);
-  if (id > 0) ((std::vector<int64_t> *)out)->push_back(id);
-  return 0;
+std::vector<std::string> TaskDB::get_tasks_query_plan(
+    const SolvePreset &preset) const {
+  // Parameters are left unbound, which does not change the plan.
+  const std::string q = "EXPLAIN QUERY PLAN " + tasks_query(preset);
+  sqlite3_stmt *stmt = nullptr;
+  if (sqlite3_prepare_v2(db_, q.c_str(), q.size() + 1, &stmt, nullptr)) {
+    LOG(ERROR) << "get_tasks_query_plan: code=" << sqlite3_errcode(db_)
+               << ": " << sqlite3_errmsg(db_) << "\nquery: " << q;
+    return {};
+  }
+  std::vector<std::string> steps;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    steps.push_back(column_text(stmt, 3));
+  }
+  sqlite3_finalize(stmt);
+  return steps;
 }
 
 std::optional<Task> TaskDB::get_task(int64_t id) const {
-  std::optional<Task> task;
-  std::ostringstream q;
-  q << "SELECT * FROM tasks WHERE id = " << id << ";";
-  if (sqlite3_exec(db_, q.str().c_str(), get_task_cb, &task, nullptr)) {
-    LOG(ERROR) << "get_task(" << id << "): code=" << sqlite3_errcode(db_)
-               << ": " << sqlite3_errmsg(db_) << "\nquery: " << q.str();
-    return {};
+  sqlite3_stmt *stmt = prepare(std::string("SELECT ") + kTaskColumns +
+                               " FROM tasks WHERE id = ?;");
+  if (!stmt) return {};
+  StatementReset reset(stmt);
+  sqlite3_bind_int64(stmt, 1, id);
+
+  switch (sqlite3_step(stmt)) {
+    case SQLITE_ROW:
+      return read_task(stmt);
+    case SQLITE_DONE:
+      return {};
   }
-  if (!task) return {};
-
-  return task;
+  LOG(ERROR) << "get_task(" << id << "): code=" << sqlite3_errcode(db_)
+             << ": " << sqlite3_errmsg(db_);
+  return {};
 }
 
 static inline bool valid_sgf_point(int board_size, std::string_view p) {
@@ -302,52 +481,71 @@ static inline bool valid_sgf_point(int board_size, std::string_view p) {
          'a' <= p[1] && p[1] <= ('a' + board_size - 1);
 }
 
-int TaskDB::get_task_cb(void *out, int /*column_count*/, char **column_value,
-                        char ** /*column_name*/) {
+std::optional<Task> TaskDB::read_task(sqlite3_stmt *stmt) {
   Task task;
 
-  task.id_ = std::stoll(column_value[0]);
-  if (column_value[1]) task.source_ = column_value[1];
-  if (column_value[2]) task.description_ = column_value[2];
-  task.type_ = TaskType(std::atoi(column_value[3]));
-  task.rank_ = Rank(std::atoi(column_value[4]));
-  if (column_value[4]) task.rating_ = std::atof(column_value[5]);
-  task.first_to_play_ = wq::Color(std::atoi(column_value[6]));
-  task.board_size_ = std::atoi(column_value[7]);
+  task.id_ = sqlite3_column_int64(stmt, 0);
+  task.source_ = column_text(stmt, 1);
+  task.description_ = column_text(stmt, 2);
+  task.type_ = TaskType(sqlite3_column_int(stmt, 3));
+  task.rank_ = Rank(sqlite3_column_int(stmt, 4));
+  task.rating_ = sqlite3_column_double(stmt, 5);
+  task.first_to_play_ = wq::Color(sqlite3_column_int(stmt, 6));
+  task.board_size_ = sqlite3_column_int(stmt, 7);
   task.top_left_ =
-      wq::Point(std::atoi(column_value[8]), std::atoi(column_value[9]));
+      wq::Point(sqlite3_column_int(stmt, 8), sqlite3_column_int(stmt, 9));
   task.bottom_right_ =
-      wq::Point(std::atoi(column_value[10]), std::atoi(column_value[11]));
+      wq::Point(sqlite3_column_int(stmt, 10), sqlite3_column_int(stmt, 11));
+
+  const auto column_json = [&](int index) {
+    const char *text = (const char *)sqlite3_column_text(stmt, index);
+    return json::parse(text, text + sqlite3_column_bytes(stmt, index));
+  };
+  try {
+    // Initial stones
+    {
+      json j = column_json(12);
+      task.initial_[0] = decode_point_list(j[0]);
+      task.initial_[1] = decode_point_list(j[1]);
+    }
 
-  // Initial stones
-  {
-    json j = json::parse(column_value[12]);
-    task.initial_[0] = decode_point_list(j[0]);
-    task.initial_[1] = decode_point_list(j[1]);
-  }
+    // Answer points
+    if (sqlite3_column_type(stmt, 13) != SQLITE_NULL) {
+      task.answer_points_ = decode_point_list(column_json(13));
+    }
 
-  // Answer points
-  if (column_value[13]) {
-    json j = json::parse(column_value[13]);
-    task.answer_points_ = decode_point_list(j);
-  }
+    // Labels
+    if (sqlite3_column_type(stmt, 14) != SQLITE_NULL) {
+      json j = column_json(14);
+      for (const auto &[p, label] : j.items()) {
+        if (valid_sgf_point(task.board_size_, p))
+          task.labels_[decode_point(p)] = label;
+      }
+    }
 
-  // Labels
-  if (column_value[14]) {
-    json j = json::parse(column_value[14]);
-    for (const auto &[p, label] : j.items()) {
-      if (valid_sgf_point(task.board_size_, p))
-        task.labels_[decode_point(p)] = label;
+    // Vtree, stored as JSON text by older versions
+    if (sqlite3_column_type(stmt, 15) == SQLITE_BLOB) {
+      auto vtree = decode_task_vtree_blob(
+          std::string_view((const char *)sqlite3_column_blob(stmt, 15),
+                           sqlite3_column_bytes(stmt, 15)),
+          task);
+      if (!vtree) {
+        LOG(ERROR) << "get_task(" << task.id_ << "): malformed vtree";
+        return {};
+      }
+      task.vtree_ = std::move(*vtree);
+    } else {
+      task.vtree_ = TaskVTree(*decode_task_vtree(column_json(15)));
+    }
+    if (sqlite3_column_type(stmt, 16) != SQLITE_NULL) {
+      task.metadata_ = column_json(16);
     }
+  } catch (const json::exception &e) {
+    LOG(ERROR) << "get_task(" << task.id_ << "): malformed task: " << e.what();
+    return {};
   }
 
-  // Vtree
-  task.vtree_ = decode_task_vtree(json::parse(column_value[15]));
-  task.metadata_ = json::parse(column_value[16]);
-
-  *((std::optional<Task> *)out) = std::move(task);
-
-  return 0;
+  return task;
 }
 
 wq::Point TaskDB::decode_point(std::string_view s) {
@@ -402,14 +600,16 @@ json TaskDB::encode_task_labels(const Task &task) {
   return ret;
 }
 
-json TaskDB::encode_task_vtree_node(const TreeNode *node) {
+json TaskDB::encode_task_vtree_node(const TaskVTree &tree,
+                                   const TaskVTree::Node &node) {
   json ret;
-  if (!node->comment_.empty()) ret["c"] = node->comment_;
-  if (node->answer_) ret["a"] = int(node->answer_.value());
-  if (!node->children_.empty()) {
+  if (node.comment_size_ > 0) ret["c"] = tree.comment(node);
+  if (node.answer_) ret["a"] = int(node.answer_.value());
+  if (node.child_count_ > 0) {
     json children;
-    for (const auto &[p, next] : node->children_) {
-      children[encode_point(p)] = encode_task_vtree_node(next.get());
+    for (auto it = tree.children_begin(node); it != tree.children_end(node);
+         ++it) {
+      children[encode_point(it->move_)] = encode_task_vtree_node(tree, *it);
     }
     ret["n"] = children;
   }
@@ -417,7 +617,210 @@ json TaskDB::encode_task_vtree_node(const TreeNode *node) {
 }
 
 json TaskDB::encode_task_vtree(const Task &task) {
-  return encode_task_vtree_node(task.vtree_.get());
+  if (task.vtree_.empty()) return json::object();
+  return encode_task_vtree_node(task.vtree_, task.vtree_.root());
+}
+
+// Layout of a vtree BLOB:
+//
+//   byte    format version, kVTreeBlobVersion
+//   varint  number of distinct comments, then each one as its varint length
+//           and bytes
+//   nodes   in preorder: a flags byte (bits 0-1 hold the answer type plus
+//           one, or zero if there is none, and bit 2 is set if there is a
+//           comment), the comment index as a varint if there is one, the
+//           child count as a varint, and then every child as its point code
+//           followed by its subtree
+//
+// Point code 0 is a pass, 1 + i is the i-th point of the task region in
+// row-major order, which takes a single byte for regions of up to 127
+// points, and 1 + region area + r * board_size + c is any other point.
+constexpr uint8_t kVTreeBlobVersion = 1;
+
+static void put_varint(uint64_t v, std::string &out) {
+  while (v >= 0x80) {
+    out += char(uint8_t(v) | 0x80);
+    v >>= 7;
+  }
+  out += char(v);
+}
+
+// Bounds-checked reader of a vtree BLOB; reads past the end set failed.
+struct VTreeBlobReader {
+  std::string_view data;
+  size_t pos = 0;
+  bool failed = false;
+
+  uint8_t byte() {
+    if (pos >= data.size()) {
+      failed = true;
+      return 0;
+    }
+    return data[pos++];
+  }
+
+  uint64_t varint() {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      const uint8_t b = byte();
+      v |= uint64_t(b & 0x7f) << shift;
+      if (!(b & 0x80)) return v;
+    }
+    failed = true;
+    return 0;
+  }
+
+  size_t remaining() const { return data.size() - pos; }
+};
+
+// Writes the subtree of node in preorder, interning comments.
+static bool encode_vtree_node(
+    const TaskVTree::Node &node, const Task &task,
+    std::unordered_map<std::string_view, uint64_t> &comment_index,
+    std::string &comments, std::string &out) {
+  const auto [r1, c1] = task.top_left_;
+  const auto [r2, c2] = task.bottom_right_;
+  const int n = task.board_size_;
+  const bool has_region = r1 <= r2 && c1 <= c2;
+  const int width = has_region ? c2 - c1 + 1 : 0;
+  const int area = has_region ? (r2 - r1 + 1) * width : 0;
+
+  const std::string_view comment = task.vtree_.comment(node);
+  uint8_t flags = node.answer_ ? 1 + (int)*node.answer_ : 0;
+  if (!comment.empty()) flags |= 4;
+  out += char(flags);
+  if (!comment.empty()) {
+    const auto [it, added] =
+        comment_index.emplace(comment, comment_index.size());
+    if (added) {
+      put_varint(comment.size(), comments);
+      comments += comment;
+    }
+    put_varint(it->second, out);
+  }
+  put_varint(node.child_count_, out);
+
+  for (auto child = task.vtree_.children_begin(node);
+       child != task.vtree_.children_end(node); ++child) {
+    const wq::Point &p = child->move_;
+    const auto &[r, c] = p;
+    if (p == wq::kPass) {
+      put_varint(0, out);
+    } else if (r1 <= r && r <= r2 && c1 <= c && c <= c2) {
+      put_varint(1 + (r - r1) * width + (c - c1), out);
+    } else if (0 <= r && r < n && 0 <= c && c < n) {
+      put_varint(1 + area + r * n + c, out);
+    } else {
+      return false;
+    }
+    if (!encode_vtree_node(*child, task, comment_index, comments, out))
+      return false;
+  }
+  return true;
+}
+
+std::optional<std::string> TaskDB::encode_task_vtree_blob(const Task &task) {
+  std::unordered_map<std::string_view, uint64_t> comment_index;
+  std::string comments;
+  std::string nodes;
+  if (task.vtree_.empty() ||
+      !encode_vtree_node(task.vtree_.root(), task, comment_index, comments,
+                         nodes)) {
+    return {};
+  }
+
+  std::string out;
+  out.reserve(1 + 5 + comments.size() + nodes.size());
+  out += char(kVTreeBlobVersion);
+  put_varint(comment_index.size(), out);
+  out += comments;
+  out += nodes;
+  return out;
+}
+
+std::optional<TaskVTree> TaskDB::decode_task_vtree_blob(
+    std::string_view data, const Task &task) {
+  const auto [r1, c1] = task.top_left_;
+  const auto [r2, c2] = task.bottom_right_;
+  const int n = task.board_size_;
+  const bool has_region = r1 <= r2 && c1 <= c2;
+  const int width = has_region ? c2 - c1 + 1 : 0;
+  const uint64_t area = has_region ? (r2 - r1 + 1) * width : 0;
+
+  VTreeBlobReader in{data};
+  if (in.byte() != kVTreeBlobVersion) return {};
+
+  // The comment table is copied as a whole and comments point into it, past
+  // their length prefixes.
+  TaskVTree tree;
+  const size_t comments_begin = in.pos;
+  std::vector<std::pair<uint32_t, uint32_t>> comments(
+      std::min<uint64_t>(in.varint(), in.remaining()));
+  for (auto &[offset, size] : comments) {
+    size = in.varint();
+    if (in.failed || size > in.remaining()) return {};
+    offset = in.pos - comments_begin;
+    in.pos += size;
+  }
+  tree.comments_ = data.substr(comments_begin, in.pos - comments_begin);
+
+  // Reads the flags, comment and child count of the i-th node and makes room
+  // for its children at the end of the array.
+  const auto read_node = [&](size_t i) {
+    const uint8_t flags = in.byte();
+    TaskVTree::Node &node = tree.nodes_[i];
+    if (flags & 3) node.answer_ = AnswerType((flags & 3) - 1);
+    if (flags & 4) {
+      const uint64_t index = in.varint();
+      if (index >= comments.size()) {
+        in.failed = true;
+        return;
+      }
+      std::tie(node.comment_offset_, node.comment_size_) = comments[index];
+    }
+    const uint64_t child_count = in.varint();
+    // Every child takes at least two bytes.
+    if (in.failed || child_count > in.remaining() / 2) {
+      in.failed = true;
+      return;
+    }
+    node.first_child_ = tree.nodes_.size();
+    node.child_count_ = child_count;
+    tree.nodes_.resize(tree.nodes_.size() + child_count);
+  };
+
+  // Nodes whose children are still being read, with the next one to read,
+  // so that deep trees do not recurse.
+  std::vector<std::pair<size_t, size_t>> stack;
+  tree.nodes_.emplace_back();
+  read_node(0);
+  stack.emplace_back(0, tree.nodes_[0].first_child_);
+  while (!stack.empty() && !in.failed) {
+    auto &[parent, next] = stack.back();
+    const TaskVTree::Node &node = tree.nodes_[parent];
+    if (next == node.first_child_ + node.child_count_) {
+      stack.pop_back();
+      continue;
+    }
+    const size_t i = next++;
+
+    const uint64_t code = in.varint();
+    wq::Point p = wq::kPass;
+    if (code > 0 && code <= area) {
+      p = wq::Point(r1 + (code - 1) / width, c1 + (code - 1) % width);
+    } else if (code > area && n > 0 && code - 1 - area < uint64_t(n) * n) {
+      p = wq::Point((code - 1 - area) / n, (code - 1 - area) % n);
+    } else if (code != 0) {
+      return {};
+    }
+    // Children are written in order, which lookups rely on.
+    if (i > node.first_child_ && !(tree.nodes_[i - 1].move_ < p)) return {};
+    tree.nodes_[i].move_ = p;
+    read_node(i);
+    stack.emplace_back(i, tree.nodes_[i].first_child_);
+  }
+  if (in.failed || in.remaining() != 0) return {};
+  return tree;
 }
 
 json TaskDB::encode_metadata(const Task &task) {
@@ -427,101 +830,95 @@ json TaskDB::encode_metadata(const Task &task) {
 }
 
 int64_t TaskDB::add_book(const Book &book) {
-  std::ostringstream q;
-  q << "INSERT INTO books (title, title_en, description, url, min_rank, "
-       "max_rank) VALUES ("
-    << "'" << book.title << "', "
-    << "'" << book.title_en << "', "
-    << "'" << book.description << "', "
-    << "'" << book.url << "', " << (int)book.min_rank << ", "
-    << (int)book.max_rank << ");";
-
-  if (sqlite3_exec(db_, q.str().c_str(), nullptr, nullptr, nullptr)) {
-    LOG(ERROR) << "add_book: code=" << sqlite3_errcode(db_) << ": "
-               << sqlite3_errmsg(db_) << "\nquery: `" << q.str() << "`";
-    return -1;
-  }
+  sqlite3_stmt *stmt = prepare(
+      "INSERT INTO books (title, title_en, description, url, min_rank, "
+      "max_rank) VALUES (?, ?, ?, ?, ?, ?);");
+  if (!stmt) return -1;
+  StatementReset reset(stmt);
+  bind_text(stmt, 1, book.title);
+  bind_text(stmt, 2, book.title_en);
+  bind_text(stmt, 3, book.description);
+  bind_text(stmt, 4, book.url);
+  sqlite3_bind_int(stmt, 5, (int)book.min_rank);
+  sqlite3_bind_int(stmt, 6, (int)book.max_rank);
+  if (!step_done(stmt, "add_book")) return -1;
 
   const int64_t book_id = sqlite3_last_insert_rowid(db_);
   return book_id;
 }
 
-int TaskDB::list_books_cb(void *out, int /*column_count*/, char **column_value,
-                          char ** /*column_name*/) {
-  Book book;
-  book.id = std::stoll(column_value[0]);
-  book.title = column_value[1];
-  book.title_en = column_value[2];
-  book.description = column_value[3];
-  book.url = column_value[4];
-  book.min_rank = Rank(std::stoi(column_value[5]));
-  book.max_rank = Rank(std::stoi(column_value[6]));
-  ((std::vector<Book> *)out)->emplace_back(book);
-  return 0;
-}
-
 std::vector<Book> TaskDB::list_books() const {
+  sqlite3_stmt *stmt = prepare(
+      "SELECT id, title, title_en, description, url, min_rank, max_rank "
+      "FROM books;");
+  if (!stmt) return {};
+  StatementReset reset(stmt);
+
   std::vector<Book> books;
-  const char *q = "SELECT * FROM books;";
-  if (sqlite3_exec(db_, q, list_books_cb, &books, nullptr)) {
+  int rc;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    Book book;
+    book.id = sqlite3_column_int64(stmt, 0);
+    book.title = column_text(stmt, 1);
+    book.title_en = column_text(stmt, 2);
+    book.description = column_text(stmt, 3);
+    book.url = column_text(stmt, 4);
+    book.min_rank = Rank(sqlite3_column_int(stmt, 5));
+    book.max_rank = Rank(sqlite3_column_int(stmt, 6));
+    books.push_back(std::move(book));
+  }
+  if (rc != SQLITE_DONE) {
     LOG(ERROR) << "list_books: code=" << sqlite3_errcode(db_) << ": "
-               << sqlite3_errmsg(db_) << "\nquery: `" << q << "`";
+               << sqlite3_errmsg(db_);
     return {};
   }
   return books;
 }
 
-int TaskDB::add_book_chapter_cb(void *out, int /*column_count*/,
-                                char **column_value, char ** /*column_name*/) {
-  *((int64_t *)out) = std::stoll(column_value[0]);
-  return 0;
-}
-
 int64_t TaskDB::add_book_chapter(int64_t book_id, const BookChapter &chapter) {
-  std::ostringstream q;
-  q << "INSERT INTO book_chapters (book_id, id, title) "
-    << "SELECT " << book_id << ", 1+COALESCE(MAX(id), 0), '" << chapter.title
-    << "' FROM book_chapters WHERE book_id = " << book_id << ";";
-
-  if (sqlite3_exec(db_, q.str().c_str(), nullptr, nullptr, nullptr)) {
-    LOG(ERROR) << "add_book_chapter: code=" << sqlite3_errcode(db_) << ": "
-               << sqlite3_errmsg(db_) << "\nquery: `" << q.str() << "`";
-    return -1;
+  sqlite3_stmt *stmt = prepare(
+      "INSERT INTO book_chapters (book_id, id, title) "
+      "SELECT ?1, 1+COALESCE(MAX(id), 0), ?2 FROM book_chapters "
+      "WHERE book_id = ?1;");
+  if (!stmt) return -1;
+  {
+    StatementReset reset(stmt);
+    sqlite3_bind_int64(stmt, 1, book_id);
+    bind_text(stmt, 2, chapter.title);
+    if (!step_done(stmt, "add_book_chapter")) return -1;
   }
 
-  int64_t chapter_id = -1;
-  q.str("");
-  q << "SELECT MAX(id) FROM book_chapters WHERE book_id = " << book_id << ";";
-  if (sqlite3_exec(db_, q.str().c_str(), add_book_chapter_cb, &chapter_id,
-                   nullptr)) {
+  stmt = prepare("SELECT MAX(id) FROM book_chapters WHERE book_id = ?;");
+  if (!stmt) return -1;
+  StatementReset reset(stmt);
+  sqlite3_bind_int64(stmt, 1, book_id);
+  if (sqlite3_step(stmt) != SQLITE_ROW) {
     LOG(ERROR) << "add_book_chapter: code=" << sqlite3_errcode(db_) << ": "
-               << sqlite3_errmsg(db_) << "\nquery: `" << q.str() << "`";
+               << sqlite3_errmsg(db_);
     return -1;
   }
-
-  return chapter_id;
-}
-
-int TaskDB::list_book_chapters_cb(void *out, int /*column_count*/,
-                                  char **column_value,
-                                  char ** /*column_name*/) {
-  BookChapter chapter;
-  chapter.book_id = std::stoll(column_value[0]);
-  chapter.id = std::stoll(column_value[1]);
-  chapter.title = column_value[2];
-  ((std::vector<BookChapter> *)out)->emplace_back(chapter);
-  return 0;
+  return sqlite3_column_int64(stmt, 0);
 }
 
 std::vector<BookChapter> TaskDB::list_book_chapters(int64_t book_id) const {
-  std::vector<BookChapter> chapters;
-  std::ostringstream q;
-  q << "SELECT * FROM book_chapters WHERE book_id = " << book_id << ";";
+  sqlite3_stmt *stmt = prepare(
+      "SELECT book_id, id, title FROM book_chapters WHERE book_id = ?;");
+  if (!stmt) return {};
+  StatementReset reset(stmt);
+  sqlite3_bind_int64(stmt, 1, book_id);
 
-  if (sqlite3_exec(db_, q.str().c_str(), list_book_chapters_cb, &chapters,
-                   nullptr)) {
+  std::vector<BookChapter> chapters;
+  int rc;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    BookChapter chapter;
+    chapter.book_id = sqlite3_column_int64(stmt, 0);
+    chapter.id = sqlite3_column_int64(stmt, 1);
+    chapter.title = column_text(stmt, 2);
+    chapters.push_back(std::move(chapter));
+  }
+  if (rc != SQLITE_DONE) {
     LOG(ERROR) << "list_book_chapters: code=" << sqlite3_errcode(db_) << ": "
-               << sqlite3_errmsg(db_) << "\nquery: `" << q.str() << "`";
+               << sqlite3_errmsg(db_);
     return {};
   }
 
@@ -530,59 +927,166 @@ std::vector<BookChapter> TaskDB::list_book_chapters(int64_t book_id) const {
 
 void TaskDB::add_book_task(int64_t book_id, int64_t chapter_id,
                            int64_t task_id) {
-  std::ostringstream q;
-  q << "INSERT INTO book_tasks (book_id, chapter_id, task_id) VALUES ("
-    << book_id << ", " << chapter_id << ", " << task_id << ");";
-
-  if (sqlite3_exec(db_, q.str().c_str(), nullptr, nullptr, nullptr)) {
-    LOG(ERROR) << "add_book_task: code=" << sqlite3_errcode(db_) << ": "
-               << sqlite3_errmsg(db_) << "\nquery: `" << q.str() << "`";
-  }
-}
-
-int TaskDB::list_book_tasks_cb(void *out, int column_count, char **column_value,
-                               char **column_name) {
-  std::optional<Task> task;
-  if (auto ret = get_task_cb(&task, column_count, column_value, column_name)) {
-    return ret;
-  }
-  ((std::vector<Task> *)out)->emplace_back(std::move(*task));
-  return 0;
+  sqlite3_stmt *stmt = prepare(
+      "INSERT INTO book_tasks (book_id, chapter_id, task_id) "
+      "VALUES (?, ?, ?);");
+  if (!stmt) return;
+  StatementReset reset(stmt);
+  sqlite3_bind_int64(stmt, 1, book_id);
+  sqlite3_bind_int64(stmt, 2, chapter_id);
+  sqlite3_bind_int64(stmt, 3, task_id);
+  step_done(stmt, "add_book_task");
 }
 
 std::vector<Task> TaskDB::list_book_tasks(
     int64_t book_id, std::optional<int64_t> chapter_id) const {
+  std::string q = std::string("SELECT ") + kTaskColumns +
+                  " FROM tasks INNER JOIN book_tasks ON "
+                  "tasks.id = book_tasks.task_id AND book_tasks.book_id = ?";
+  if (chapter_id) q += " AND book_tasks.chapter_id = ?";
+  q += ";";
+  sqlite3_stmt *stmt = prepare(q);
+  if (!stmt) return {};
+  StatementReset reset(stmt);
+  sqlite3_bind_int64(stmt, 1, book_id);
+  if (chapter_id) sqlite3_bind_int64(stmt, 2, *chapter_id);
+
   std::vector<Task> tasks;
-  std::ostringstream q;
-  q << "SELECT * FROM tasks "
-    << "INNER JOIN book_tasks ON "
-    << "tasks.id = book_tasks.task_id AND "
-    << "book_tasks.book_id = " << book_id;
-  if (chapter_id) q << " AND book_tasks.chapter_id = " << *chapter_id;
-  q << ";";
-  if (sqlite3_exec(db_, q.str().c_str(), list_book_tasks_cb, &tasks, nullptr)) {
+  int rc;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    // Like the rest of the query, a malformed task aborts the listing.
+    auto task = read_task(stmt);
+    if (!task) return {};
+    tasks.push_back(std::move(*task));
+  }
+  if (rc != SQLITE_DONE) {
     LOG(ERROR) << "list_book_tasks: code=" << sqlite3_errcode(db_) << ": "
-               << sqlite3_errmsg(db_) << "\nquery: `" << q.str() << "`";
+               << sqlite3_errmsg(db_);
     return {};
   }
   return tasks;
 }
 
+TaskDB::BulkWriter::BulkWriter(TaskDB &db, int batch_size)
+    : db_(db), batch_size_(batch_size) {
+  // Indexes are cheaper to build once over the final tables than to update
+  // on every insert. Those backing PRIMARY KEY constraints have no SQL and
+  // stay. They are dropped in the first batch, so that they are only gone
+  // once rows are committed without them; if the import is interrupted
+  // before finish(), the next TaskDB to open the file rebuilds them.
+  exec("BEGIN;");
+  sqlite3_stmt *stmt = db_.prepare(
+      "SELECT name, sql FROM sqlite_master WHERE type = 'index' AND "
+      "sql IS NOT NULL;");
+  std::vector<std::string> names;
+  if (stmt) {
+    StatementReset reset(stmt);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      names.push_back(column_text(stmt, 0));
+      index_sql_.push_back(column_text(stmt, 1));
+    }
+  }
+  for (const auto &name : names) {
+    exec(("DROP INDEX \"" + name + "\";").c_str());
+  }
+}
+
+TaskDB::BulkWriter::~BulkWriter() {
+  if (!finished_) finish();
+}
+
+int64_t TaskDB::BulkWriter::add_tag(std::string_view tag_name) {
+  auto it = tag_ids_.find(std::string(tag_name));
+  if (it != tag_ids_.end()) return it->second;
+  const int64_t id = db_.add_tag(tag_name);
+  if (id != -1) tag_ids_.emplace(tag_name, id);
+  inserted();
+  return id;
+}
+
+int64_t TaskDB::BulkWriter::add_task(const Task &task) {
+  const int64_t id = db_.add_task(task);
+  inserted();
+  return id;
+}
+
+void TaskDB::BulkWriter::add_book_task(int64_t book_id, int64_t chapter_id,
+                                       int64_t task_id) {
+  db_.add_book_task(book_id, chapter_id, task_id);
+  inserted();
+}
+
+bool TaskDB::BulkWriter::finish() {
+  finished_ = true;
+  bool ok = exec("COMMIT;");
+  for (const auto &sql : index_sql_) ok &= exec(sql.c_str());
+  index_sql_.clear();
+  return ok;
+}
+
+bool TaskDB::BulkWriter::exec(const char *sql) {
+  if (sqlite3_exec(db_.db_, sql, nullptr, nullptr, nullptr)) {
+    LOG(ERROR) << "bulk writer: code=" << sqlite3_errcode(db_.db_) << ": "
+               << sqlite3_errmsg(db_.db_) << "\nquery: `" << sql << "`";
+    return false;
+  }
+  return true;
+}
+
+void TaskDB::BulkWriter::inserted() {
+  if (++pending_ < batch_size_) return;
+  pending_ = 0;
+  exec("COMMIT;");
+  exec("BEGIN;");
+}
+
+TaskVTree::TaskVTree(const TreeNode &root) {
+  // Breadth first, so that the children of every node are next to each
+  // other.
+  std::vector<const TreeNode *> sources = {&root};
+  nodes_.emplace_back();
+  for (size_t i = 0; i < sources.size(); ++i) {
+    const TreeNode *source = sources[i];
+    Node &node = nodes_[i];
+    node.answer_ = source->answer_;
+    node.comment_offset_ = comments_.size();
+    node.comment_size_ = source->comment_.size();
+    comments_ += source->comment_;
+    node.first_child_ = nodes_.size();
+    node.child_count_ = source->children_.size();
+    for (const auto &[p, child] : source->children_) {
+      nodes_.emplace_back().move_ = p;
+      sources.push_back(child.get());
+    }
+  }
+}
+
+const TaskVTree::Node *TaskVTree::child(const Node &node,
+                                        const wq::Point &p) const {
+  const Node *end = children_end(node);
+  const Node *it = std::lower_bound(
+      children_begin(node), end, p,
+      [](const Node &child, const wq::Point &p) { return child.move_ < p; });
+  return it != end && it->move_ == p ? it : nullptr;
+}
+
 TaskVTreeIterator::TaskVTreeIterator(const Task &task) : task_(task) {
   reset();
 }
 
 std::optional<AnswerType> TaskVTreeIterator::move(wq::Point p,
                                                   std::string &comment) {
-  auto it = cur_->children_.find(p);
-  if (it == cur_->children_.end()) return AnswerType::kWrong;
+  const TaskVTree::Node *next = cur_ ? task_.vtree_.child(*cur_, p) : nullptr;
+  if (!next) return AnswerType::kWrong;
 
-  cur_ = it->second.get();
-  comment = cur_->comment_;
+  cur_ = next;
+  comment = task_.vtree_.comment(*cur_);
   return cur_->answer_;
 }
 
-void TaskVTreeIterator::reset() { cur_ = task_.vtree_.get(); }
+void TaskVTreeIterator::reset() {
+  cur_ = task_.vtree_.empty() ? nullptr : &task_.vtree_.root();
+}
 
 const char *rank_string(Rank rank) {
   switch (rank) {
@@ -43,7 +43,6 @@ std::optional<Task> import_101weiqi_task(std::string_view data) {
   if (task.description_.empty() && e.contains("name") && !e["name"].is_null()) {
     task.description_ = e["name"];
   }
-  std::replace(task.description_.begin(), task.description_.end(), '\'', ';');
   task.rating_ = e["vote"];
   task.type_ = TaskType((int)e["qtype"]);
   task.rank_ = parse_101weiqi_rank(std::string(e["levelname"]));
@@ -54,13 +53,13 @@ std::optional<Task> import_101weiqi_task(std::string_view data) {
 
   task.metadata_["public_id"] = std::to_string((int)e["publicid"]);
 
-  task.vtree_ = std::make_unique<TreeNode>();
+  TreeNode vtree;
   for (const auto& ans : e["answers"]) {
     if (ans["st"] != 2) continue;
     if (ans["ty"] == 2) continue;  // skip variations
     if (ans["pts"].empty()) continue;
 
-    TreeNode* cur = task.vtree_.get();
+    TreeNode* cur = &vtree;
     for (const auto& cp : ans["pts"]) {
       const std::string& cps = cp["p"];
 
@@ -77,7 +76,6 @@ std::optional<Task> import_101weiqi_task(std::string_view data) {
           next->comment_ = c;
           if (next->comment_ == " ") next->comment_.clear();
           std::replace(next->comment_.begin(), next->comment_.end(), '\n', ' ');
-          std::replace(next->comment_.begin(), next->comment_.end(), '\'', ';');
         }
         cur->children_[p] = std::move(next);
       }
@@ -97,6 +95,7 @@ std::optional<Task> import_101weiqi_task(std::string_view data) {
       }
     }
   }
+  task.vtree_ = TaskVTree(vtree);
 
   const int r = (int)e["r"];
 
@@ -0,0 +1,227 @@
+#include "task_verify.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "log.h"
+
+namespace {
+
+// Task ids owned by one worker. The owner takes them from the front and idle
+// workers steal from the back.
+class WorkQueue {
+ public:
+  void push(int64_t id) { ids_.push_back(id); }
+
+  bool pop(int64_t &id) {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (ids_.empty()) return false;
+    id = ids_.front();
+    ids_.pop_front();
+    return true;
+  }
+
+  bool steal(int64_t &id) {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (ids_.empty()) return false;
+    id = ids_.back();
+    ids_.pop_back();
+    return true;
+  }
+
+ private:
+  std::mutex mu_;
+  std::deque<int64_t> ids_;
+};
+
+}  // namespace
+
+static const char *move_status_string(wq::MoveStatus status) {
+  switch (status) {
+    case wq::MoveStatus::kLegal:
+      return "legal";
+    case wq::MoveStatus::kOutside:
+      return "out of bounds";
+    case wq::MoveStatus::kOccupied:
+      return "occupied point";
+    case wq::MoveStatus::kSuicide:
+      return "suicide";
+    case wq::MoveStatus::kRepetition:
+      return "ko violation";
+  }
+  return "?";
+}
+
+static std::string point_string(int board_size, const wq::Point &p) {
+  if (p == wq::kPass) return "tt";
+  const auto &[r, c] = p;
+  std::ostringstream out;
+  if (0 <= r && r < board_size && 0 <= c && c < board_size) {
+    out << (char)('a' + c) << (char)('a' + r);
+  } else {
+    out << "(" << r << "," << c << ")";
+  }
+  return out.str();
+}
+
+static void verify_vtree(const Task &task, wq::Board &board,
+                         const TaskVTree::Node &node, wq::Color turn,
+                         std::string &path, std::vector<TaskProblem> &out) {
+  const wq::Color next_turn =
+      turn == wq::Color::kBlack ? wq::Color::kWhite : wq::Color::kBlack;
+  for (auto child = task.vtree_.children_begin(node);
+       child != task.vtree_.children_end(node); ++child) {
+    const wq::Point &p = child->move_;
+    const size_t path_size = path.size();
+    if (!path.empty()) path += ' ';
+    path += point_string(task.board_size_, p);
+
+    if (p == wq::kPass) {
+      board.pass(turn);
+      verify_vtree(task, board, *child, next_turn, path, out);
+      int ur, uc;
+      wq::PointList added;
+      board.undo(ur, uc, added);
+    } else {
+      const auto &[r, c] = p;
+      const wq::MoveStatus status = board.move_status(turn, r, c);
+      if (status != wq::MoveStatus::kLegal) {
+        // Nothing below an illegal move can be replayed.
+        out.push_back({task.id_, path, move_status_string(status)});
+      } else {
+        wq::PointList removed;
+        board.move(turn, r, c, removed);
+        verify_vtree(task, board, *child, next_turn, path, out);
+        int ur, uc;
+        wq::PointList added;
+        board.undo(ur, uc, added);
+      }
+    }
+    path.resize(path_size);
+  }
+}
+
+std::vector<TaskProblem> verify_task(const Task &task) {
+  std::vector<TaskProblem> problems;
+  const int n = task.board_size_;
+  if (n < 1 || n > wq::kMaxBoardSize) {
+    problems.push_back(
+        {task.id_, "", "invalid board size " + std::to_string(n)});
+    return problems;
+  }
+
+  const auto [r1, c1] = task.top_left_;
+  const auto [r2, c2] = task.bottom_right_;
+  if (r1 < 0 || c1 < 0 || r2 >= n || c2 >= n || r1 > r2 || c1 > c2) {
+    problems.push_back({task.id_, "", "invalid board region"});
+  }
+
+  wq::Board board(n, n);
+  wq::PointList removed;
+  const wq::Color colors[2] = {wq::Color::kBlack, wq::Color::kWhite};
+  for (int i = 0; i < 2; ++i) {
+    for (const auto &p : task.initial_[i]) {
+      const auto &[r, c] = p;
+      const wq::MoveStatus status = board.move_status(colors[i], r, c);
+      if (status != wq::MoveStatus::kLegal) {
+        problems.push_back({task.id_, "",
+                            std::string("initial ") +
+                                wq::color_string(colors[i]) + " stone at " +
+                                point_string(n, p) + ": " +
+                                move_status_string(status)});
+        continue;
+      }
+      board.move(colors[i], r, c, removed);
+      if (!removed.empty()) {
+        problems.push_back({task.id_, "",
+                            std::string("initial ") +
+                                wq::color_string(colors[i]) + " stone at " +
+                                point_string(n, p) + ": captures stones"});
+      }
+    }
+  }
+
+  if (task.first_to_play_ != wq::Color::kBlack &&
+      task.first_to_play_ != wq::Color::kWhite) {
+    problems.push_back({task.id_, "", "invalid first player"});
+    return problems;
+  }
+  if (task.vtree_.empty()) return problems;
+
+  std::string path;
+  verify_vtree(task, board, task.vtree_.root(), task.first_to_play_, path,
+               problems);
+  return problems;
+}
+
+TaskVerifyReport verify_tasks(const char *db_path, int thread_count) {
+  if (thread_count <= 0)
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+  std::vector<int64_t> ids = TaskDB(db_path, true).get_tasks(SolvePreset());
+  std::vector<WorkQueue> queues(thread_count);
+  for (size_t i = 0; i < ids.size(); ++i) {
+    queues[i % thread_count].push(ids[i]);
+  }
+
+  TaskVerifyReport report;
+  report.task_count = ids.size();
+  std::mutex report_mu;
+
+  const auto worker = [&](int index) {
+    TaskDB db(db_path, true);
+    std::vector<TaskProblem> problems;
+    int64_t id;
+    while (true) {
+      bool found = queues[index].pop(id);
+      for (int k = 1; k < thread_count && !found; ++k) {
+        found = queues[(index + k) % thread_count].steal(id);
+      }
+      // No ids are added once the workers start, so empty queues mean the
+      // work is done.
+      if (!found) break;
+
+      const auto task = db.get_task(id);
+      if (!task) {
+        problems.push_back({id, "", "cannot load task"});
+        continue;
+      }
+      for (auto &p : verify_task(*task)) problems.push_back(std::move(p));
+    }
+
+    std::lock_guard<std::mutex> lock(report_mu);
+    for (auto &p : problems) report.problems.push_back(std::move(p));
+  };
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < thread_count; ++i) workers.emplace_back(worker, i);
+  for (auto &t : workers) t.join();
+
+  std::stable_sort(report.problems.begin(), report.problems.end(),
+                   [](const TaskProblem &a, const TaskProblem &b) {
+                     return a.task_id < b.task_id;
+                   });
+  return report;
+}
+
+int verify_tasks_main(const char *db_path, int thread_count) {
+  const auto start = std::chrono::steady_clock::now();
+  const TaskVerifyReport report = verify_tasks(db_path, thread_count);
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  for (const auto &p : report.problems) {
+    std::cout << "task " << p.task_id;
+    if (!p.path.empty()) std::cout << " [" << p.path << "]";
+    std::cout << ": " << p.message << std::endl;
+  }
+  LOG(INFO) << "verify tasks: " << report.task_count << " tasks, "
+            << report.problems.size() << " problems in " << elapsed.count()
+            << "s";
+  return report.problems.empty() ? 0 : 1;
+}
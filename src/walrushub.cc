@@ -1,7 +1,17 @@
+#include <cstdlib>
+#include <string_view>
+
 #include "app_context.h"
 #include "main_window.h"
+#include "task_verify.h"
 
 int main(int argc, char **argv) {
+  // Batch mode: WalrusHub --verify-tasks [thread_count]
+  if (argc >= 2 && std::string_view(argv[1]) == "--verify-tasks") {
+    return verify_tasks_main("assets/tasks.db",
+                             argc >= 3 ? std::atoi(argv[2]) : 0);
+  }
+
   AppContext app_ctx("assets/tasks.db", "stats.db",
                      [](AppContext &app_ctx) { new ui::MainWindow(app_ctx); });
   return app_ctx.run(argc, argv);
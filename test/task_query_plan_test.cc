@@ -0,0 +1,94 @@
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "task.h"
+
+// Checks with EXPLAIN QUERY PLAN that the task selection queries of presets
+// are answered from indexes, without reading task rows, on a scratch
+// database set up and migrated by TaskDB.
+
+namespace {
+
+Task make_task(const char* source, TaskType type, Rank rank) {
+  Task task;
+  task.source_ = source;
+  task.type_ = type;
+  task.rating_ = 1;
+  task.rank_ = rank;
+  task.first_to_play_ = wq::Color::kBlack;
+  task.board_size_ = 19;
+  task.top_left_ = wq::Point(0, 0);
+  task.bottom_right_ = wq::Point(8, 8);
+  task.vtree_ = TaskVTree(TreeNode());
+  return task;
+}
+
+}  // namespace
+
+int main() {
+  const std::string path =
+      (std::filesystem::temp_directory_path() / "task_query_plan_test.db")
+          .string();
+  std::remove(path.c_str());
+
+  // Filters used together by the presets of the training window, and every
+  // filter at once.
+  std::vector<SolvePreset> presets(4);
+  presets[0].types_ = {TaskType::kLifeAndDeath, TaskType::kTesuji,
+                       TaskType::kCapture, TaskType::kCaptureRace};
+  presets[0].min_rank_ = Rank::k1K;
+  presets[0].max_rank_ = Rank::k1D;
+  presets[1].tags_ = {"tag"};
+  presets[1].min_rank_ = Rank::k1K;
+  presets[1].max_rank_ = Rank::k1D;
+  presets[2].tags_ = {"tag"};
+  presets[3].sources_ = {"source"};
+  presets[3].tags_ = {"tag"};
+  presets[3].types_ = {TaskType::kLifeAndDeath};
+  presets[3].min_rank_ = Rank::k1K;
+  presets[3].max_rank_ = Rank::k1D;
+  presets[3].min_rating_ = 1;
+  presets[3].min_board_size_ = 9;
+  presets[3].max_board_size_ = 19;
+  // Tasks each preset selects among the ones added below.
+  const size_t expected[] = {2, 1, 2, 1};
+
+  int failures = 0;
+  {
+    TaskDB db(path.c_str());
+    Task task = make_task("source", TaskType::kLifeAndDeath, Rank::k1D);
+    task.tags_ = {db.add_tag("tag")};
+    db.add_task(task);
+    task = make_task("other", TaskType::kTesuji, Rank::k1K);
+    db.add_task(task);
+    task = make_task("source", TaskType::kLifeAndDeath, Rank::k5D);
+    db.add_task(task);
+    db.add_task(task);
+    task.tags_ = {db.get_tag_id("tag")};
+    db.add_task(task);
+
+    for (size_t i = 0; i < presets.size(); ++i) {
+      // Steps searching or scanning a table other than through a covering
+      // index read its rows.
+      for (const std::string& step : db.get_tasks_query_plan(presets[i])) {
+        if ((step.rfind("SCAN ", 0) == 0 || step.rfind("SEARCH ", 0) == 0) &&
+            step.find("COVERING INDEX") == std::string::npos) {
+          std::cerr << "preset " << i << " reads table rows: " << step
+                    << std::endl;
+          failures++;
+        }
+      }
+      const size_t count = db.get_tasks(presets[i]).size();
+      if (count != expected[i]) {
+        std::cerr << "preset " << i << " selects " << count << " tasks, not "
+                  << expected[i] << std::endl;
+        failures++;
+      }
+    }
+  }
+  std::remove(path.c_str());
+  return failures == 0 ? 0 : 1;
+}